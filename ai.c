@@ -0,0 +1,515 @@
+/** @file ai.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Computer player for the engine, used to autoplay a board and to drive the host simulations.
+ */
+
+#include "ai.h"
+
+#include <string.h>
+
+#include "ai_weights.h"
+
+/**
+ * Weights used when none are given, generated by the tuner into `ai_weights.h`.
+ */
+const ai_weights_t ai_default_weights = {
+    .lines = AI_WEIGHT_LINES,
+    .height = AI_WEIGHT_HEIGHT,
+    .holes = AI_WEIGHT_HOLES,
+    .bumpiness = AI_WEIGHT_BUMPINESS,
+};
+
+/**
+ * @brief Whether two orientations have the same shape, so they give the same placements.
+ */
+static bool ai_same_shape(const PIECE_FLASH piece_shape_t* a, const PIECE_FLASH piece_shape_t* b)
+{
+    if (a->max_x - a->min_x != b->max_x - b->min_x || a->max_y - a->min_y != b->max_y - b->min_y)
+        return false;
+
+    for (uint8_t row = 0; row <= a->max_y - a->min_y; row++)
+    {
+        if (a->rows[a->min_y + row] >> a->min_x != b->rows[b->min_y + row] >> b->min_x)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Initialise a computer player.
+ * @param weights Weights to score boards with, or NULL for `ai_default_weights`.
+ * @param depth Number of pieces to search, from 1 (only the current piece) to `AI_MAX_DEPTH`. 0 for `AI_DEFAULT_DEPTH`.
+ * @param beam_width Number of boards kept after each piece, up to `AI_MAX_BEAM_WIDTH`. 0 for `AI_DEFAULT_BEAM_WIDTH`.
+ */
+void ai_init(ai_t* ai, const ai_weights_t* weights, uint8_t depth, uint8_t beam_width)
+{
+    memset(ai, 0, sizeof(ai_t));
+    ai->weights = weights ? *weights : ai_default_weights;
+    ai->depth = depth == 0 ? AI_DEFAULT_DEPTH : depth > AI_MAX_DEPTH ? AI_MAX_DEPTH : depth;
+    ai->beam_width = beam_width == 0 ? AI_DEFAULT_BEAM_WIDTH : beam_width > AI_MAX_BEAM_WIDTH ? AI_MAX_BEAM_WIDTH : beam_width;
+
+    ttable_init(&ai->own_table, ai->own_entries, AI_TABLE_SIZE);
+    ai->table = &ai->own_table;
+
+    // the O piece has one shape, and the I, S and Z pieces have two
+    for (uint8_t idx = 0; idx < PIECES_COUNT; idx++)
+    {
+        for (uint8_t orientation = 0; orientation < PIECE_NUM_ROTATIONS; orientation++)
+        {
+            bool unique = true;
+            for (uint8_t earlier = 0; earlier < orientation && unique; earlier++)
+                unique = !ai_same_shape(&pieces[idx][orientation], &pieces[idx][earlier]);
+
+            if (unique)
+                ai->unique_orientations[idx] |= 1 << orientation;
+        }
+    }
+}
+
+/**
+ * @brief Search with `table` instead of the player's own transposition table, or without a table if NULL.
+ *        A table can be shared by players on many threads, as long as they all use the same weights.
+ *        Must be called after `ai_init`.
+ */
+void ai_set_table(ai_t* ai, ttable_t* table)
+{
+    ai->table = table;
+}
+
+/**
+ * @brief Score a board by the weighted sum of its features.
+ * @param lines Lines cleared by the placements leading to this board.
+ */
+int32_t ai_evaluate(const ai_weights_t* weights, const board_t* board, uint8_t lines)
+{
+    int16_t height = 0;
+    int16_t bumpiness = 0;
+    for (uint8_t x = 0; x < BOARD_WIDTH; x++)
+    {
+        height += board->heights[x];
+        if (x > 0)
+            bumpiness += board->heights[x] > board->heights[x - 1] ? board->heights[x] - board->heights[x - 1]
+                                                                     : board->heights[x - 1] - board->heights[x];
+    }
+
+    // a hole is an empty tile in a column that has a filled tile above it
+    int16_t holes = 0;
+    uint8_t covered = 0;
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+    {
+        holes += __builtin_popcount(covered & ~board->rows[y]);
+        covered |= board->rows[y];
+    }
+
+    return (int32_t)weights->lines * lines + (int32_t)weights->height * height + (int32_t)weights->holes * holes
+           + (int32_t)weights->bumpiness * bumpiness;
+}
+
+/**
+ * @brief Find every placement of `piece` that can be reached from where it is, by rotating and then moving sideways.
+ * @param placements Caller provided array that receives up to `AI_MAX_PLACEMENTS` placements.
+ * @return The number of placements found.
+ */
+uint8_t ai_generate(const ai_t* ai, const board_t* board, const piece_t* piece, ai_placement_t* placements)
+{
+    uint8_t count = 0;
+    for (uint8_t orientation = 0; orientation < PIECE_NUM_ROTATIONS; orientation++)
+    {
+        // the orientation the piece is in is always tried, so there is at least one placement
+        if (orientation != piece->orientation && !(ai->unique_orientations[piece->idx] & (1 << orientation)))
+            continue;
+
+        // rotate the shortest way round, as `ai_next_input` does, so the piece is kicked to the same place
+        piece_t rotated = *piece;
+        if (orientation != piece->orientation)
+        {
+            board_t scratch = *board;
+            uint8_t turns = (orientation - piece->orientation) & (PIECE_NUM_ROTATIONS - 1);
+            bool clockwise = turns != PIECE_NUM_ROTATIONS - 1;
+            bool reachable = true;
+            for (uint8_t i = 0; i < (clockwise ? turns : 1) && reachable; i++)
+                reachable = piece_rotate(&scratch, &rotated, clockwise);
+
+            if (!reachable)
+                continue;
+        }
+
+        // move as far left as possible, then drop the piece in every column on the way back to the right
+        int8_t y = rotated.pos.y;
+        while (board_valid_position(board, &rotated, rotated.pos.x - 1, y, orientation))
+            rotated.pos.x--;
+
+        for (; board_valid_position(board, &rotated, rotated.pos.x, y, orientation); rotated.pos.x++)
+        {
+            placements[count++] = (ai_placement_t){
+                .x = rotated.pos.x,
+                .y = board_landing_y(board, &rotated),
+                .orientation = orientation,
+            };
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Key of a board and piece in the cache, the board's rows packed together with the piece's index.
+ *        Exact rather than a hash, so a cached entry is never used for the wrong board.
+ */
+static uint64_t ai_cache_key(const board_t* board, uint8_t idx)
+{
+    uint64_t key = idx + 1;  // never 0, which marks an empty entry
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+        key = (key << BOARD_WIDTH) | board->rows[y];
+    return key;
+}
+
+/**
+ * @brief Placements of the piece `idx` spawned on `board`, from the cache if the board and piece have been seen before.
+ * @return The number of placements, 0 if the piece can't be spawned.
+ */
+static uint8_t ai_generate_spawned(ai_t* ai, const board_t* board, uint8_t idx, const ai_placement_t** placements)
+{
+    uint64_t key = ai_cache_key(board, idx);
+
+    // fibonacci hashing of the folded key picks the entry
+    uint32_t folded = (uint32_t)key ^ (uint32_t)(key >> 32);
+    ai_cache_entry_t* entry = &ai->cache[(uint32_t)(folded * 0x9E3779B9u) >> 16 & (AI_CACHE_SIZE - 1)];
+    *placements = entry->placements;
+    ai->cache_lookups++;
+    if (entry->key == key)
+    {
+        ai->cache_hits++;
+        return entry->count;
+    }
+
+    piece_t piece = {.idx = idx, .pos = {PIECE_SPAWN_X, PIECE_SPAWN_Y}, .orientation = ORIENTATION_NORTH};
+    entry->key = key;
+    entry->count = 0;
+    if (board_valid_position(board, &piece, piece.pos.x, piece.pos.y, piece.orientation))
+        entry->count = ai_generate(ai, board, &piece, entry->placements);
+
+    return entry->count;
+}
+
+/**
+ * @brief Insert `node` into `beam`, which is sorted from the best score to the worst, if it is one of the best `width`.
+ */
+static void ai_beam_insert(ai_node_t* beam, uint8_t* size, uint8_t width, const ai_node_t* node)
+{
+    if (*size == width && node->score <= beam[width - 1].score)
+        return;
+
+    // the same board reached by different placements is only kept once, with its best score, so it is only expanded once
+    for (uint8_t i = 0; i < *size; i++)
+    {
+        if (memcmp(beam[i].board.rows, node->board.rows, BOARD_HEIGHT) != 0)
+            continue;
+
+        if (beam[i].score >= node->score)
+            return;
+
+        memmove(&beam[i], &beam[i + 1], (*size - i - 1) * sizeof(ai_node_t));
+        (*size)--;
+        break;
+    }
+
+    uint8_t i = *size < width ? (*size)++ : width - 1;
+    for (; i > 0 && beam[i - 1].score < node->score; i--)
+        beam[i] = beam[i - 1];
+    beam[i] = *node;
+}
+
+/**
+ * @brief Drop the piece `idx` at `placement` onto a copy of `parent`, and score the resulting board.
+ * @param next The piece spawned after this one, the board scores `AI_SCORE_DEAD` if it can't be spawned.
+ */
+static void ai_place(ai_t* ai, const ai_node_t* parent, uint8_t idx, const ai_placement_t* placement, uint8_t next,
+                     ai_node_t* child)
+{
+    child->board = parent->board;
+    child->root = parent->root;
+
+    piece_t piece = {.idx = idx, .pos = {placement->x, placement->y}, .orientation = placement->orientation};
+    child->lines = parent->lines + board_place_piece(&child->board, &piece);
+
+    piece_t spawned = {.idx = next, .pos = {PIECE_SPAWN_X, PIECE_SPAWN_Y}, .orientation = ORIENTATION_NORTH};
+    if (board_valid_position(&child->board, &spawned, spawned.pos.x, spawned.pos.y, spawned.orientation))
+        child->score = ai_evaluate(&ai->weights, &child->board, child->lines);
+    else
+        child->score = AI_SCORE_DEAD + child->lines;
+
+    ai->placements++;
+}
+
+/**
+ * @brief Drop the piece `idx` at `placement` onto a copy of `parent`, and insert the resulting board into `beam`.
+ */
+static void ai_expand(ai_t* ai, const ai_node_t* parent, uint8_t idx, const ai_placement_t* placement, uint8_t next,
+                      ai_node_t* beam, uint8_t* size)
+{
+    ai_node_t child;
+    ai_place(ai, parent, idx, placement, next, &child);
+    ai_beam_insert(beam, size, ai->beam_width, &child);
+}
+
+/**
+ * @brief Score of the board reached from `parent` by a placement that scored `score` from the same board with no lines cleared.
+ *        A board where the next piece can't spawn scores by the number of lines, any other board by the weighted lines.
+ */
+static int32_t ai_add_lines(const ai_t* ai, int32_t score, uint8_t lines)
+{
+    return score < AI_SCORE_DEAD / 2 ? score + lines : score + (int32_t)ai->weights.lines * lines;
+}
+
+/**
+ * @brief Find the best of `placements` for the last piece of the search, the one that leads to the best scoring board.
+ *        Scored with no lines cleared before it. The best placement doesn't depend on the lines cleared before,
+ *        so this is the same for every way the board is reached.
+ * @param best Set to the index of the best placement.
+ */
+static int32_t ai_best_placement(ai_t* ai, const board_t* board, uint8_t idx, const ai_placement_t* placements, uint8_t count,
+                                 uint8_t next, uint8_t* best)
+{
+    ai_node_t start = {.board = *board, .score = 0, .lines = 0, .root = 0};
+    int32_t best_score = INT32_MIN;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        ai_node_t child;
+        ai_place(ai, &start, idx, &placements[i], next, &child);
+        if (child.score > best_score)
+        {
+            best_score = child.score;
+            *best = i;
+        }
+    }
+
+    return best_score;
+}
+
+/**
+ * @brief Key of a position in the transposition table: the board's rows, then each piece searched (idx + 1),
+ *        the number of pieces, and the beam width the search used (0 if the result doesn't depend on it).
+ *        Exact rather than a hash, 35 + 3 * 5 + 3 + 5 bits, so a result is never used for the wrong position.
+ */
+static uint64_t ai_table_key(const board_t* board, const uint8_t* sequence, uint8_t count, uint8_t beam_width)
+{
+    uint64_t key = beam_width;
+    key = (key << 3) | count;
+    for (uint8_t i = 0; i < count; i++)
+        key = (key << 3) | (sequence[i] + 1);
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+        key = (key << BOARD_WIDTH) | board->rows[y];
+    return key;
+}
+
+/**
+ * @brief Data of a position in the transposition table, the score in the low 32 bits and then the best placement.
+ */
+static uint64_t ai_table_pack(int32_t score, const ai_placement_t* placement)
+{
+    return (uint32_t)score | (uint64_t)(uint8_t)placement->x << 32 | (uint64_t)(uint8_t)placement->y << 40
+           | (uint64_t)placement->orientation << 48;
+}
+
+static int32_t ai_table_unpack(uint64_t data, ai_placement_t* placement)
+{
+    placement->x = (int8_t)(data >> 32);
+    placement->y = (int8_t)(data >> 40);
+    placement->orientation = (uint8_t)(data >> 48);
+    return (int32_t)(uint32_t)data;
+}
+
+/**
+ * @brief Look up a position in the transposition table.
+ * @return false if there is no table, or the position isn't in it.
+ */
+static bool ai_table_probe(ai_t* ai, uint64_t key, int32_t* score, ai_placement_t* best)
+{
+    if (!ai->table)
+        return false;
+
+    uint64_t data;
+    ai->table_lookups++;
+    if (!ttable_probe(ai->table, key, &data))
+        return false;
+
+    ai->table_hits++;
+    *score = ai_table_unpack(data, best);
+    return true;
+}
+
+static void ai_table_store(ai_t* ai, uint64_t key, int32_t score, const ai_placement_t* best)
+{
+    if (ai->table)
+        ttable_store(ai->table, key, ai_table_pack(score, best));
+}
+
+/**
+ * @brief The best placement of the piece `idx` spawned on `board`, as the last piece of the search, from the
+ *        transposition table if the board and pieces have been searched before. The piece must be able to spawn.
+ * @return The score of the best placement, with no lines cleared before it.
+ */
+static int32_t ai_search_last(ai_t* ai, const board_t* board, uint8_t idx, uint8_t next, ai_placement_t* best)
+{
+    uint8_t sequence[2] = {idx, next};
+    uint64_t key = ai_table_key(board, sequence, 2, 0);
+    int32_t score;
+    if (ai_table_probe(ai, key, &score, best))
+        return score;
+
+    const ai_placement_t* placements;
+    uint8_t count = ai_generate_spawned(ai, board, idx, &placements);
+    uint8_t index = 0;
+    score = ai_best_placement(ai, board, idx, placements, count, next, &index);
+    *best = placements[index];
+
+    ai_table_store(ai, key, score, best);
+    return score;
+}
+
+/**
+ * @brief Search for the best placement of the engine's current piece.
+ * @param best Set to the chosen placement.
+ * @return The score of the best board found at the end of the search.
+ */
+int32_t ai_choose(ai_t* ai, engine_t* engine, ai_placement_t* best)
+{
+    // the current piece, then the upcoming pieces. One more than the depth, to check the last board can spawn a piece
+    uint8_t sequence[AI_MAX_DEPTH + 1];
+    sequence[0] = engine->current_piece.idx;
+    for (uint8_t i = 1; i <= ai->depth; i++)
+        sequence[i] = engine_peek_next(engine, i - 1);
+
+    // the current piece may have moved, so the placements and results are only reused while it is where it spawned
+    const piece_t* current = &engine->current_piece;
+    bool spawned = current->pos.x == PIECE_SPAWN_X && current->pos.y == PIECE_SPAWN_Y && current->orientation == ORIENTATION_NORTH;
+    if (spawned && ai->depth == 1)
+        return ai_search_last(ai, &engine->board, sequence[0], sequence[1], best);
+
+    int32_t score;
+    uint64_t key = ai_table_key(&engine->board, sequence, ai->depth + 1, ai->beam_width);
+    if (spawned && ai_table_probe(ai, key, &score, best))
+        return score;
+
+    // copied out of the cache, as the entry can be replaced during the search
+    ai_placement_t roots[AI_MAX_PLACEMENTS];
+    uint8_t num_roots;
+    if (spawned)
+    {
+        const ai_placement_t* cached;
+        num_roots = ai_generate_spawned(ai, &engine->board, current->idx, &cached);
+        memcpy(roots, cached, num_roots * sizeof(ai_placement_t));
+    }
+    else
+        num_roots = ai_generate(ai, &engine->board, current, roots);
+
+    // the current piece always fits where it is, so there is at least one root
+    if (ai->depth == 1)
+    {
+        uint8_t index = 0;
+        score = ai_best_placement(ai, &engine->board, sequence[0], roots, num_roots, sequence[1], &index);
+        *best = roots[index];
+        return score;
+    }
+
+    // every piece but the last keeps a beam of the best boards, so the beam is never empty
+    ai_node_t* beam = ai->beams[0];
+    uint8_t size = 0;
+    ai_node_t start = {.board = engine->board, .score = 0, .lines = 0};
+    for (uint8_t i = 0; i < num_roots; i++)
+    {
+        start.root = i;
+        ai_expand(ai, &start, sequence[0], &roots[i], sequence[1], beam, &size);
+    }
+
+    for (uint8_t depth = 1; depth < ai->depth - 1; depth++)
+    {
+        ai_node_t* parents = beam;
+        uint8_t num_parents = size;
+        beam = ai->beams[depth & 1];
+        size = 0;
+
+        for (uint8_t i = 0; i < num_parents; i++)
+        {
+            // a board that couldn't spawn this piece is kept as it is, so a dying move is still chosen if nothing else survives
+            if (parents[i].score < AI_SCORE_DEAD / 2)
+            {
+                ai_beam_insert(beam, &size, ai->beam_width, &parents[i]);
+                continue;
+            }
+
+            const ai_placement_t* placements;
+            uint8_t count = ai_generate_spawned(ai, &parents[i].board, sequence[depth], &placements);
+            for (uint8_t j = 0; j < count; j++)
+                ai_expand(ai, &parents[i], sequence[depth], &placements[j], sequence[depth + 1], beam, &size);
+        }
+    }
+
+    // only the best board is needed after the last piece, so each board's best placement is looked up in the table
+    uint8_t last = ai->depth - 1;
+    uint8_t best_root = beam[0].root;
+    score = INT32_MIN;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        // a board that can't spawn the last piece keeps its score
+        int32_t board_score = beam[i].score;
+        if (board_score >= AI_SCORE_DEAD / 2)
+        {
+            ai_placement_t placement;
+            board_score = ai_add_lines(ai, ai_search_last(ai, &beam[i].board, sequence[last], sequence[last + 1], &placement),
+                                       beam[i].lines);
+        }
+
+        if (board_score > score)
+        {
+            score = board_score;
+            best_root = beam[i].root;
+        }
+    }
+
+    *best = roots[best_root];
+    if (spawned)
+        ai_table_store(ai, key, score, best);
+    return score;
+}
+
+/**
+ * @brief Returns the next input to move the current piece towards its chosen placement, choosing a placement
+ *        whenever a new piece has spawned. Once the piece is in place, or can't get any closer, it is hard dropped.
+ *        Should be called once per tick, and its input applied before the next call. `ai_init` must be called
+ *        again at the start of each round.
+ */
+engine_input_t ai_next_input(ai_t* ai, engine_t* engine)
+{
+    if (engine->state != ENGINE_STATE_PLAYING)
+        return ENGINE_INPUT_NONE;
+
+    const piece_t* piece = &engine->current_piece;
+    if (ai->target_piece != engine->pieces_spawned)
+    {
+        ai_choose(ai, engine, &ai->target);
+        ai->target_piece = engine->pieces_spawned;
+    }
+    else if (piece->pos.x == ai->last_piece.pos.x && piece->pos.y == ai->last_piece.pos.y
+             && piece->orientation == ai->last_piece.orientation)
+    {
+        // the last input didn't move the piece, so it can't get any closer
+        return ENGINE_INPUT_DROP;
+    }
+    ai->last_piece = *piece;
+
+    uint8_t turns = (ai->target.orientation - piece->orientation) & (PIECE_NUM_ROTATIONS - 1);
+    if (turns != 0)
+        return turns == PIECE_NUM_ROTATIONS - 1 ? ENGINE_INPUT_ROTATE_CCW : ENGINE_INPUT_ROTATE;
+
+    if (piece->pos.x < ai->target.x)
+        return ENGINE_INPUT_RIGHT;
+
+    if (piece->pos.x > ai->target.x)
+        return ENGINE_INPUT_LEFT;
+
+    return ENGINE_INPUT_DROP;
+}
\ No newline at end of file
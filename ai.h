@@ -0,0 +1,178 @@
+/** @file ai.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Computer player for the engine, used to autoplay a board and to drive the host simulations.
+ *
+ *  Every placement of a piece (orientation and column) that can be reached by rotating then moving
+ *  sideways from where the piece is, is dropped onto a copy of the board and scored by a weighted sum of
+ *  features of the resulting board. A beam search keeps the best `beam_width` boards after each piece,
+ *  and tries every placement of the next piece on each of them, for `depth` pieces (the current piece,
+ *  then the upcoming pieces). The current piece is moved to the placement that leads to the best board.
+ *
+ *  Search results are kept in a transposition table, keyed by the board and the pieces searched, so a
+ *  position reached again (in a later search, or another game sharing the table) is not searched again.
+ */
+
+#ifndef AI_H
+#define AI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "engine.h"
+#include "piece.h"
+#include "ttable.h"
+
+/** Most placements a piece can have, each orientation can be at most `BOARD_WIDTH` columns */
+#define AI_MAX_PLACEMENTS (PIECE_NUM_ROTATIONS * BOARD_WIDTH)
+
+/** Most pieces the search can look at, the current piece and `AI_MAX_DEPTH - 1` upcoming pieces */
+#define AI_MAX_DEPTH 4
+
+#ifdef __AVR__
+// Keep the AI small enough to fit in RAM alongside the game
+#define AI_MAX_BEAM_WIDTH 2
+#define AI_CACHE_SIZE     1
+#define AI_TABLE_SIZE     8
+#else
+#define AI_MAX_BEAM_WIDTH 16
+#define AI_CACHE_SIZE     256   // must be a power of 2
+#define AI_TABLE_SIZE     1024  // must be a power of 2
+#endif
+
+/** Search settings used by `ai_init` when none are given */
+#define AI_DEFAULT_DEPTH      2
+#define AI_DEFAULT_BEAM_WIDTH AI_MAX_BEAM_WIDTH
+
+/** Score of a board where the next piece can't be spawned */
+#define AI_SCORE_DEAD (INT32_MIN / 2)
+
+/**
+ * Weights of the features a board is scored by, the score is the sum of each feature multiplied by its weight.
+ * Features that make a board worse should have negative weights.
+ */
+typedef struct {
+    /** lines cleared by the placements leading to the board */
+    int16_t lines;
+
+    /** sum of the column heights */
+    int16_t height;
+
+    /** empty tiles with a filled tile somewhere above them */
+    int16_t holes;
+
+    /** sum of the differences in height between neighbouring columns */
+    int16_t bumpiness;
+} ai_weights_t;
+
+/** Weights used when none are given */
+extern const ai_weights_t ai_default_weights;
+
+/** Where a piece is placed, the piece lands at row `y` when dropped in column `x` */
+typedef struct {
+    int8_t x;
+    int8_t y;
+    uint8_t orientation;
+} ai_placement_t;
+
+/** A board in the beam search, reached by placing the first `depth` pieces */
+typedef struct {
+    board_t board;
+    int32_t score;
+    uint8_t lines;
+
+    /** index of the current piece's placement this board was reached from */
+    uint8_t root;
+} ai_node_t;
+
+/** Placements of a piece spawned on a board, reused when the same board and piece are searched again */
+typedef struct {
+    /** the board's rows and the piece, see `ai_cache_key`. 0 if the entry is empty */
+    uint64_t key;
+    uint8_t count;
+    ai_placement_t placements[AI_MAX_PLACEMENTS];
+} ai_cache_entry_t;
+
+/**
+ * The state of one computer player. Everything it needs is stored here, so multiple players can be run side by side.
+ */
+typedef struct {
+    ai_weights_t weights;
+    uint8_t depth;
+    uint8_t beam_width;
+
+    /** bit `orientation` is set if that orientation of the piece has a different shape to every earlier orientation */
+    uint8_t unique_orientations[PIECES_COUNT];
+
+    /** the boards kept after the previous piece, and the boards being kept after the current piece */
+    ai_node_t beams[2][AI_MAX_BEAM_WIDTH];
+
+    ai_cache_entry_t cache[AI_CACHE_SIZE];
+
+    /** the transposition table searched, the player's own table unless it has been given a shared one */
+    ttable_t* table;
+    ttable_t own_table;
+    ttable_entry_t own_entries[AI_TABLE_SIZE];
+
+    /** the placement the current piece is being moved to, and the value of `pieces_spawned` it was chosen for */
+    ai_placement_t target;
+    uint16_t target_piece;
+
+    /** where the current piece was when the last input was chosen, to notice when an input has no effect */
+    piece_t last_piece;
+
+    /** number of placements scored, and the number of times the cache was searched and had the placements */
+    uint32_t placements;
+    uint32_t cache_lookups;
+    uint32_t cache_hits;
+
+    /** number of times the transposition table was searched, and had the result */
+    uint32_t table_lookups;
+    uint32_t table_hits;
+} ai_t;
+
+/**
+ * @brief Initialise a computer player.
+ * @param weights Weights to score boards with, or NULL for `ai_default_weights`.
+ * @param depth Number of pieces to search, from 1 (only the current piece) to `AI_MAX_DEPTH`. 0 for `AI_DEFAULT_DEPTH`.
+ * @param beam_width Number of boards kept after each piece, up to `AI_MAX_BEAM_WIDTH`. 0 for `AI_DEFAULT_BEAM_WIDTH`.
+ */
+void ai_init(ai_t* ai, const ai_weights_t* weights, uint8_t depth, uint8_t beam_width);
+
+/**
+ * @brief Search with `table` instead of the player's own transposition table, or without a table if NULL.
+ *        A table can be shared by players on many threads, as long as they all use the same weights.
+ *        Must be called after `ai_init`.
+ */
+void ai_set_table(ai_t* ai, ttable_t* table);
+
+/**
+ * @brief Score a board by the weighted sum of its features.
+ * @param lines Lines cleared by the placements leading to this board.
+ */
+int32_t ai_evaluate(const ai_weights_t* weights, const board_t* board, uint8_t lines);
+
+/**
+ * @brief Find every placement of `piece` that can be reached from where it is, by rotating and then moving sideways.
+ * @param placements Caller provided array that receives up to `AI_MAX_PLACEMENTS` placements.
+ * @return The number of placements found.
+ */
+uint8_t ai_generate(const ai_t* ai, const board_t* board, const piece_t* piece, ai_placement_t* placements);
+
+/**
+ * @brief Search for the best placement of the engine's current piece.
+ * @param best Set to the chosen placement.
+ * @return The score of the best board found at the end of the search.
+ */
+int32_t ai_choose(ai_t* ai, engine_t* engine, ai_placement_t* best);
+
+/**
+ * @brief Returns the next input to move the current piece towards its chosen placement, choosing a placement
+ *        whenever a new piece has spawned. Once the piece is in place, or can't get any closer, it is hard dropped.
+ *        Should be called once per tick, and its input applied before the next call. `ai_init` must be called
+ *        again at the start of each round.
+ */
+engine_input_t ai_next_input(ai_t* ai, engine_t* engine);
+
+#endif  // AI_H
\ No newline at end of file
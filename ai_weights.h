@@ -0,0 +1,18 @@
+/** @file ai_weights.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Weights of the AI board evaluator, compiled in as `ai_default_weights`.
+ *
+ *  Generated by `./tune`, do not edit by hand. The fittest of generation 49 (seed 1), which cleared
+ *  25.6 lines per game over 100 games, searching 2 pieces with a beam width of 2.
+ */
+
+#ifndef AI_WEIGHTS_H
+#define AI_WEIGHTS_H
+
+#define AI_WEIGHT_LINES     3
+#define AI_WEIGHT_HEIGHT    -104
+#define AI_WEIGHT_HOLES     -147
+#define AI_WEIGHT_BUMPINESS -77
+
+#endif  // AI_WEIGHTS_H
\ No newline at end of file
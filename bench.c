@@ -0,0 +1,540 @@
+/** @file bench.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Microbenchmarks for the board, piece and AI hot paths, run on a host machine.
+ *
+ *  Each benchmark is run several times and the fastest run is reported, in ns/op and cycles/op.
+ *  Results are written as JSON (one benchmark per line), and can be compared against a recorded baseline.
+ *
+ *  Usage: ./bench [-n iterations] [-o output.json] [-b baseline.json] [-t threshold_percent]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#endif
+
+#include "ai.h"
+#include "board.h"
+#include "piece.h"
+
+#define BENCH_MAX_RESULTS         64
+#define BENCH_NAME_LEN            48
+#define BENCH_REPEATS             5
+#define BENCH_DEFAULT_ITERATIONS  2000000
+#define BENCH_DEFAULT_THRESHOLD   25  // percent slower than the baseline before the check fails
+
+typedef struct {
+    char name[BENCH_NAME_LEN];
+    double ns_per_op;
+    double cycles_per_op;
+} bench_result_t;
+
+/** Function being benchmarked, runs `iterations` operations */
+typedef void (*bench_func_t)(uint32_t iterations, void* arg);
+
+static bench_result_t results[BENCH_MAX_RESULTS];
+static uint8_t num_results = 0;
+
+/** Results are accumulated in here so the compiler can't optimise the benchmarks away */
+static volatile uint32_t sink;
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t cycles_now(void)
+{
+#ifdef HAVE_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Run the benchmark `BENCH_REPEATS` times, and record the fastest run.
+ *        Exits if `BENCH_MAX_RESULTS` benchmarks have already been run.
+ */
+static void bench_run(const char* name, bench_func_t func, void* arg, uint32_t iterations)
+{
+    if (num_results == BENCH_MAX_RESULTS)
+    {
+        fprintf(stderr, "too many benchmarks, raise BENCH_MAX_RESULTS to run %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    bench_result_t* result = &results[num_results++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->ns_per_op = -1;
+
+    for (uint8_t i = 0; i < BENCH_REPEATS; i++)
+    {
+        double start = time_now();
+        uint64_t start_cycles = cycles_now();
+        func(iterations, arg);
+        uint64_t cycles = cycles_now() - start_cycles;
+        double ns = time_now() - start;
+
+        if (result->ns_per_op < 0 || ns / iterations < result->ns_per_op)
+        {
+            result->ns_per_op = ns / iterations;
+            result->cycles_per_op = (double)cycles / iterations;
+        }
+    }
+
+    fprintf(stderr, "%-32s %8.2f ns/op %8.2f cycles/op\n", result->name, result->ns_per_op, result->cycles_per_op);
+}
+
+/**
+ * Every piece, orientation and x position tested by the position benchmarks, including invalid ones.
+ */
+#define BENCH_NUM_POSITIONS (PIECES_COUNT * PIECE_NUM_ROTATIONS * (BOARD_WIDTH + 4))
+static piece_t positions[BENCH_NUM_POSITIONS];
+
+static void init_positions(void)
+{
+    uint16_t i = 0;
+    for (uint8_t idx = 0; idx < PIECES_COUNT; idx++)
+        for (uint8_t orientation = 0; orientation < PIECE_NUM_ROTATIONS; orientation++)
+            for (int8_t x = -2; x < BOARD_WIDTH + 2; x++)
+                positions[i++] = (piece_t){.idx = idx, .pos = {x, 3}, .orientation = orientation};
+}
+
+/**
+ * @brief A partially filled board, so collision checks have something to collide with.
+ */
+static const board_t bench_board = {
+    .rows = {0x00, 0x00, 0x00, 0x00, 0x11, 0x1B, 0x1E},
+};
+
+static void bench_valid_position(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        const piece_t* piece = &positions[i % BENCH_NUM_POSITIONS];
+        valid += board_valid_position(&bench_board, piece, piece->pos.x, piece->pos.y, piece->orientation);
+    }
+    sink = valid;
+}
+
+static void bench_get_points(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    point_t points[PIECE_NUM_POINTS];
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        const piece_t* piece = &positions[i % BENCH_NUM_POSITIONS];
+        piece_get_points(piece, piece->pos.x, piece->pos.y, piece->orientation, points);
+        total += points[i % PIECE_NUM_POINTS].x;
+    }
+    sink = total;
+}
+
+static void bench_rotate(uint32_t iterations, void* arg)
+{
+    bool kicks = arg != NULL;
+    board_t board;
+    board_init(&board);
+
+    // a T piece in the middle of an empty board can rotate freely
+    piece_t piece = {.idx = 5, .pos = {1, 2}, .orientation = ORIENTATION_NORTH};
+    if (kicks)
+    {
+        // the worst case, a vertical I piece in a well one column wide, so every wall kick is tried and fails
+        for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+            board.rows[y] = BOARD_FULL_ROW & ~BOARD_TILE_BIT(3);
+        piece = (piece_t){.idx = 0, .pos = {1, 2}, .orientation = ORIENTATION_SOUTH};
+    }
+
+    uint32_t rotated = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        rotated += piece_rotate(&board, &piece, true);
+    sink = rotated;
+}
+
+static void bench_move(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    board_t board;
+    board_init(&board);
+
+    // move left and right alternately, so the piece stays in the middle of the board
+    piece_t piece = {.idx = 5, .pos = {1, 2}, .orientation = ORIENTATION_NORTH};
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        moved += piece_move(&board, &piece, i & 1 ? DIRECTION_LEFT : DIRECTION_RIGHT);
+    sink = moved;
+}
+
+/**
+ * @brief The pieces from `positions` that are valid at the top of `board`, to be dropped by the landing benchmarks.
+ * @return The number of pieces written to `drops`.
+ */
+static uint16_t init_drops(const board_t* board, piece_t* drops)
+{
+    uint16_t num_drops = 0;
+    for (uint16_t i = 0; i < BENCH_NUM_POSITIONS; i++)
+    {
+        piece_t piece = positions[i];
+        piece.pos.y = 0;
+        if (board_valid_position(board, &piece, piece.pos.x, piece.pos.y, piece.orientation))
+            drops[num_drops++] = piece;
+    }
+
+    return num_drops;
+}
+
+static void bench_landing_y(uint32_t iterations, void* arg)
+{
+    bool stepped = arg != NULL;
+    board_t board = bench_board;
+    board_update_heights(&board);
+
+    piece_t drops[BENCH_NUM_POSITIONS];
+    uint16_t num_drops = init_drops(&board, drops);
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        const piece_t* piece = &drops[i % num_drops];
+        if (!stepped)
+        {
+            total += board_landing_y(&board, piece);
+            continue;
+        }
+
+        // what a hard drop would cost without the column heights, moving down one row at a time
+        int8_t y = piece->pos.y;
+        while (board_valid_position(&board, piece, piece->pos.x, y + 1, piece->orientation))
+            y++;
+        total += y;
+    }
+    sink = total;
+}
+
+/**
+ * Board where dropping a vertical I piece into the right most column clears `clears` lines.
+ * The other rows the I piece covers are left with a gap, so they are not cleared.
+ */
+static board_t make_clear_board(uint8_t clears)
+{
+    board_t board = {.rows = {0x00, 0x00, 0x00, 0x05, 0x0A, 0x05, 0x0A}};
+    for (uint8_t i = 0; i < clears; i++)
+        board.rows[BOARD_HEIGHT - 1 - i] = BOARD_FULL_ROW & ~BOARD_TILE_BIT(BOARD_WIDTH - 1);
+    board_update_heights(&board);
+    return board;
+}
+
+static void bench_place_piece(uint32_t iterations, void* arg)
+{
+    const board_t* template = arg;
+
+    // vertical I piece in the right most column, covering the bottom 4 rows
+    const piece_t piece = {.idx = 0, .pos = {BOARD_WIDTH - 3, BOARD_HEIGHT - 4}, .orientation = ORIENTATION_SOUTH};
+    uint32_t cleared = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        board_t board = *template;
+        cleared += board_place_piece(&board, &piece);
+    }
+    sink = cleared;
+}
+
+static void bench_clear_lines(uint32_t iterations, void* arg)
+{
+    const board_t* template = arg;
+    uint32_t cleared = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        board_t board = *template;
+        cleared += board_clear_lines(&board);
+    }
+    sink = cleared;
+}
+
+/**
+ * Engines part way through a game played by the AI, so the AI benchmarks search realistic boards.
+ */
+#define BENCH_NUM_STATES 256
+static engine_t states[BENCH_NUM_STATES];
+
+static void init_states(void)
+{
+    static ai_t ai;
+    ai_init(&ai, NULL, 0, 0);
+
+    engine_t engine;
+    engine_init(&engine, 1);
+    for (uint16_t i = 0; i < BENCH_NUM_STATES; i++)
+    {
+        // start a new game when the AI dies
+        if (engine.state != ENGINE_STATE_PLAYING)
+        {
+            engine_init(&engine, i);
+            ai_init(&ai, NULL, 0, 0);
+        }
+
+        states[i] = engine;
+
+        engine_input_t input;
+        do
+        {
+            input = ai_next_input(&ai, &engine);
+            engine_input(&engine, input);
+        } while (input != ENGINE_INPUT_DROP);
+        engine_tick(&engine);
+    }
+}
+
+static void bench_ai_evaluate(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    int32_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        total += ai_evaluate(&ai_default_weights, &states[i % BENCH_NUM_STATES].board, 0);
+    sink = total;
+}
+
+static void bench_ai_generate(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    static ai_t ai;
+    ai_init(&ai, NULL, 0, 0);
+
+    ai_placement_t placements[AI_MAX_PLACEMENTS];
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        const engine_t* engine = &states[i % BENCH_NUM_STATES];
+        total += ai_generate(&ai, &engine->board, &engine->current_piece, placements);
+    }
+    sink = total;
+}
+
+/**
+ * @brief A whole search for the current piece's placement, at the default depth and beam width.
+ *        Reports the time per placement scored as well, printed after the benchmark.
+ */
+static void bench_ai_choose(uint32_t iterations, void* arg)
+{
+    static ai_t ai;
+    ai_init(&ai, NULL, 0, 0);
+    ai_set_table(&ai, NULL);
+
+    ai_placement_t best;
+    int32_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        total += ai_choose(&ai, &states[i % BENCH_NUM_STATES], &best);
+    sink = total;
+
+    *(double*)arg = (double)ai.placements / iterations;
+}
+
+/**
+ * @brief A search for a position already in the transposition table, with a table big enough for every state's search.
+ */
+static void bench_ai_choose_table(uint32_t iterations, void* arg)
+{
+    (void)arg;
+    static ttable_entry_t entries[1 << 16];
+    static ttable_t table;
+    ttable_init(&table, entries, 1 << 16);
+
+    static ai_t ai;
+    ai_init(&ai, NULL, 0, 0);
+    ai_set_table(&ai, &table);
+
+    ai_placement_t best;
+    int32_t total = 0;
+    for (uint16_t i = 0; i < BENCH_NUM_STATES; i++)
+        ai_choose(&ai, &states[i], &best);
+
+    for (uint32_t i = 0; i < iterations; i++)
+        total += ai_choose(&ai, &states[i % BENCH_NUM_STATES], &best);
+    sink = total;
+}
+
+/**
+ * @brief Write the results as JSON, one benchmark per line so the baseline can be read back easily.
+ */
+static void write_json(FILE* file)
+{
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (uint8_t i = 0; i < num_results; i++)
+    {
+        fprintf(
+            file,
+            "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"cycles_per_op\": %.3f}%s\n",
+            results[i].name,
+            results[i].ns_per_op,
+            results[i].cycles_per_op,
+            i + 1 < num_results ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+/**
+ * @brief Compare the results against a baseline written by `write_json`.
+ *        Benchmarks that are only in one of them are reported, and those missing from the results fail the check.
+ * @return Whether every benchmark in the baseline was run, and is within `threshold` percent of it.
+ */
+static bool check_baseline(const char* path, double threshold)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "could not open baseline %s\n", path);
+        return false;
+    }
+
+    bool passed = true;
+    bool compared[BENCH_MAX_RESULTS] = {false};
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[BENCH_NAME_LEN];
+        double ns_per_op;
+        if (sscanf(line, " {\"name\": \"%47[^\"]\", \"ns_per_op\": %lf", name, &ns_per_op) != 2)
+            continue;
+
+        uint8_t i = 0;
+        while (i < num_results && strcmp(results[i].name, name) != 0)
+            i++;
+
+        // a benchmark that was renamed or dropped would otherwise pass without being compared
+        if (i == num_results)
+        {
+            fprintf(stderr, "%-32s %8.2f ns/op in the baseline, but was not run MISSING\n", name, ns_per_op);
+            passed = false;
+            continue;
+        }
+
+        compared[i] = true;
+        double change = (results[i].ns_per_op - ns_per_op) / ns_per_op * 100;
+        bool regressed = change > threshold;
+        fprintf(stderr, "%-32s %8.2f -> %8.2f ns/op (%+6.1f%%)%s\n", name, ns_per_op, results[i].ns_per_op, change, regressed ? " REGRESSION" : "");
+        passed &= !regressed;
+    }
+
+    // new benchmarks don't fail the check, but should be recorded with `baseline`
+    for (uint8_t i = 0; i < num_results; i++)
+    {
+        if (!compared[i])
+            fprintf(stderr, "%-32s %8.2f ns/op, not in the baseline NEW\n", results[i].name, results[i].ns_per_op);
+    }
+
+    fclose(file);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char* output = NULL;
+    const char* baseline = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:b:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'b':
+            baseline = optarg;
+            break;
+
+        case 't':
+            threshold = strtod(optarg, NULL);
+            break;
+
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-o output.json] [-b baseline.json] [-t threshold_percent]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    init_positions();
+    bench_run("board_valid_position", bench_valid_position, NULL, iterations);
+    bench_run("piece_get_points", bench_get_points, NULL, iterations);
+    bench_run("piece_rotate", bench_rotate, NULL, iterations);
+    bench_run("piece_rotate/kicks", bench_rotate, (void*)1, iterations);
+    bench_run("piece_move", bench_move, NULL, iterations);
+    bench_run("board_landing_y", bench_landing_y, NULL, iterations);
+    bench_run("board_landing_y/stepped", bench_landing_y, (void*)1, iterations);
+
+    init_states();
+    bench_run("ai_evaluate", bench_ai_evaluate, NULL, iterations);
+    bench_run("ai_generate", bench_ai_generate, NULL, iterations);
+
+    // a search scores many placements, so it is run fewer times (but at least once, for small -n)
+    double placements_per_choose = 0;
+    uint32_t choose_iterations = iterations / 100 ? iterations / 100 : 1;
+    bench_run("ai_choose", bench_ai_choose, &placements_per_choose, choose_iterations);
+    fprintf(stderr, "ai_choose scores %.1f placements per search, %.0f placements/s\n", placements_per_choose,
+            placements_per_choose * 1e9 / results[num_results - 1].ns_per_op);
+    bench_run("ai_choose/table_hit", bench_ai_choose_table, NULL, iterations);
+
+    board_t clear_boards[5];
+    for (uint8_t clears = 0; clears <= 4; clears++)
+    {
+        char name[BENCH_NAME_LEN];
+        clear_boards[clears] = make_clear_board(clears);
+        snprintf(name, sizeof(name), "board_place_piece/clears=%u", clears);
+        bench_run(name, bench_place_piece, &clear_boards[clears], iterations);
+    }
+
+    // the same boards with the piece already placed, to time just the line clear
+    board_t full_boards[5];
+    for (uint8_t clears = 0; clears <= 4; clears++)
+    {
+        char name[BENCH_NAME_LEN];
+        full_boards[clears] = clear_boards[clears];
+        for (uint8_t y = BOARD_HEIGHT - 4; y < BOARD_HEIGHT; y++)
+            full_boards[clears].rows[y] |= BOARD_TILE_BIT(BOARD_WIDTH - 1);
+        board_update_heights(&full_boards[clears]);
+        snprintf(name, sizeof(name), "board_clear_lines/clears=%u", clears);
+        bench_run(name, bench_clear_lines, &full_boards[clears], iterations);
+    }
+
+    if (output)
+    {
+        FILE* file = fopen(output, "w");
+        if (!file)
+        {
+            fprintf(stderr, "could not open %s\n", output);
+            return EXIT_FAILURE;
+        }
+        write_json(file);
+        fclose(file);
+    }
+    else
+        write_json(stdout);
+
+    if (baseline && !check_baseline(baseline, threshold))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
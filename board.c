@@ -8,56 +8,44 @@
 
 #include <string.h>
 
-#include "game_data.h"
-#include "packet.h"
-
 /**
- * @brief Initialises the board state
- * @param board Pass by reference `board` to be initialized
+ * @brief Initialises the board state, clearing all tiles.
+ * @param board The board to be initialised
  */
-void board_init(board_t** board)
+void board_init(board_t* board)
 {
-    // On first run we malloc the board pointer, and continue to reuse it for the rest of the program
-    static bool init = false;
-    if (!init)
-    {
-        *board = malloc(sizeof(board_t));
-        init = true;
-    }
-
-    memset(*board, 0, sizeof(board_t));
-
-    // board->pieces are all set to 0 from above call to memset
-    // nothing else to do here
+    memset(board, 0, sizeof(board_t));
+    board->dirty_rows = BOARD_ALL_ROWS;
 }
 
 /**
  * @returns whether the given tetris piece, at the given coordinates and orientation, is at a valid position on the board.
  *          i.e. it does not collide with any placed pieces or extend outside the bounds of the LED display.
  *
- * @param board The global `board` object
+ * @param board The board to test against
  * @param piece The piece to check is valid
  * @param x The x coordinate of the piece to test
  * @param y The y coordinate of the piece to test
  * @param orientation The orientation of the piece to test
  */
-bool board_valid_position(board_t* board, piece_t* piece, uint8_t x, uint8_t y, orientation_t orientation)
+bool board_valid_position(const board_t* board, const piece_t* piece, int8_t x, int8_t y, orientation_t orientation)
 {
-    const tinygl_point_t* points = piece_get_points(piece, x, y, orientation);
-    for (uint8_t i = 0; i < PIECE_NUM_POINTS; i++)
-    {
-        tinygl_point_t point = points[i];
+    const PIECE_FLASH piece_shape_t* shape = &pieces[piece->idx][orientation];
 
-        // x bounds check
-        if (point.x >= TINYGL_WIDTH || point.x < 0)
-            return false;
+    // x bounds check
+    if (x + shape->min_x < 0 || x + shape->max_x >= BOARD_WIDTH)
+        return false;
 
-        // y bounds check
-        if (point.y >= TINYGL_HEIGHT || point.y < 0)
-            return false;
+    // y bounds check
+    if (y + shape->min_y < 0 || y + shape->max_y >= BOARD_HEIGHT)
+        return false;
 
-        // this point collides with a placed piece on the board
-        if (board->tiles[point.x][point.y])
+    // a row of the piece collides with a placed piece on the board
+    // x may be negative when the piece's grid has empty columns on the left
+    for (uint8_t row = shape->min_y; row <= shape->max_y; row++)
+    {
+        uint8_t mask = x >= 0 ? shape->rows[row] << x : shape->rows[row] >> -x;
+        if (board->rows[y + row] & mask)
             return false;
     }
 
@@ -65,41 +53,106 @@ bool board_valid_position(board_t* board, piece_t* piece, uint8_t x, uint8_t y,
 }
 
 /**
- * @brief Shift all the rows above the given `row` down
- * @param board The board object, (`game_data->board`)
- * @param row The rows above this `row` will be shifted down.
- *            This will essentially the clear this row.
+ * @brief Recompute `heights` from the rows, for a board whose rows were set directly.
  */
-void board_shift_down(board_t* board, uint8_t row)
+void board_update_heights(board_t* board)
 {
-    for (uint8_t y = row; y > 0; y--)
-        for (uint8_t x = 0; x < TINYGL_WIDTH; x++)
-            board->tiles[x][y] = board->tiles[x][y - 1];
+    memset(board->heights, 0, sizeof(board->heights));
+
+    // the first row (from the top) each column has a tile in is its height
+    uint8_t seen = 0;
+    for (uint8_t y = 0; y < BOARD_HEIGHT && seen != BOARD_FULL_ROW; y++)
+    {
+        uint8_t first = board->rows[y] & ~seen;
+        seen |= first;
+        for (uint8_t x = 0; first; x++, first >>= 1)
+        {
+            if (first & 1)
+                board->heights[x] = BOARD_HEIGHT - y;
+        }
+    }
 }
 
 /**
- * @brief Checks and clears any rows that are full. Shifts the board's points appropriately.
+ * @brief Returns the row the given piece would land on if it was dropped straight down from its current position.
+ *        Found from the column heights and the piece's bottom profile, checking at most 4 columns. Only when the
+ *        piece is below an overhang does it fall back to moving the piece down one row at a time.
+ * @param board The board to drop the piece on
+ * @param piece The piece to drop, must be at a valid position
+ */
+int8_t board_landing_y(const board_t* board, const piece_t* piece)
+{
+    const PIECE_FLASH piece_shape_t* shape = &pieces[piece->idx][piece->orientation];
+
+    // the lowest tile of each column of the piece must stay above the highest tile of the board's column
+    int8_t landing_y = INT8_MAX;
+    for (uint8_t column = shape->min_x; column <= shape->max_x; column++)
+    {
+        int8_t y = BOARD_HEIGHT - 1 - board->heights[piece->pos.x + column] - shape->bottom[column];
+        if (y < landing_y)
+            landing_y = y;
+    }
+
+    // the piece has been moved under an overhang, the column heights are above it
+    if (landing_y < piece->pos.y)
+    {
+        landing_y = piece->pos.y;
+        while (board_valid_position(board, piece, piece->pos.x, landing_y + 1, piece->orientation))
+            landing_y++;
+    }
+
+    return landing_y;
+}
+
+/**
+ * @brief Checks and clears any rows that are full. Shifts the board's rows appropriately.
  * @return uint8_t The number of lines cleared
  */
 uint8_t board_clear_lines(board_t* board)
 {
     uint8_t num_clears = 0;
-    for (uint8_t y = 0; y < TINYGL_HEIGHT; y++)
+    uint8_t top_cleared = 0;
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+    {
+        if (board->rows[y] != BOARD_FULL_ROW)
+            continue;
+
+        if (!num_clears)
+            top_cleared = y;
+
+        // shift all the rows above this row down by one, which clears this row
+        memmove(&board->rows[1], &board->rows[0], y);
+        board->rows[0] = 0;
+        board->dirty_rows |= (1 << (y + 1)) - 1;
+        num_clears++;
+    }
+
+    if (!num_clears)
+        return 0;
+
+    // A cleared row is full, so the highest tile of every column was in or above the highest cleared row.
+    // Columns with a tile above it just drop by the number of lines cleared, the others lost their highest
+    // tile and have to find the next one down.
+    uint8_t rescan = 0;
+    for (uint8_t x = 0; x < BOARD_WIDTH; x++)
     {
-        bool full_row = true;
-        for (uint8_t x = 0; x < TINYGL_WIDTH; x++)
+        if (board->heights[x] == BOARD_HEIGHT - top_cleared)
         {
-            if (!board->tiles[x][y])
-            {
-                full_row = false;
-                break;
-            }
+            rescan |= BOARD_TILE_BIT(x);
+            board->heights[x] = 0;
         }
+        else
+            board->heights[x] -= num_clears;
+    }
 
-        if (full_row)
+    for (uint8_t y = top_cleared; y < BOARD_HEIGHT && rescan; y++)
+    {
+        uint8_t first = board->rows[y] & rescan;
+        rescan &= ~first;
+        for (uint8_t x = 0; first; x++, first >>= 1)
         {
-            board_shift_down(board, y);
-            num_clears++;
+            if (first & 1)
+                board->heights[x] = BOARD_HEIGHT - y;
         }
     }
 
@@ -107,27 +160,26 @@ uint8_t board_clear_lines(board_t* board)
 }
 
 /**
- * @brief Place the given tetris piece at its current position on the board
- * @param board The board to place the piece on. (`game_data->board`)
- * @param piece The piece to be placed on the board. (`game_data->piece`)
+ * @brief Place the given tetris piece at its current position on the board, and clear any full rows.
+ * @param board The board to place the piece on.
+ * @param piece The piece to be placed on the board.
+ * @return The number of lines cleared by placing the piece.
  */
-void board_place_piece(board_t* board, piece_t* piece)
+uint8_t board_place_piece(board_t* board, const piece_t* piece)
 {
-    const tinygl_point_t* points = piece_get_points(piece, piece->pos.x, piece->pos.y, piece->orientation);
+    point_t points[PIECE_NUM_POINTS];
+    piece_get_points(piece, piece->pos.x, piece->pos.y, piece->orientation, points);
 
     for (uint8_t i = 0; i < PIECE_NUM_POINTS; i++)
     {
-        tinygl_point_t point = points[i];
-        board->tiles[point.x][point.y] = true;
-    }
+        point_t point = points[i];
+        board->rows[point.y] |= BOARD_TILE_BIT(point.x);
 
-    uint8_t lines_cleared = board_clear_lines(board);
-    game_data->our_lines_cleared += lines_cleared;
+        uint8_t height = BOARD_HEIGHT - point.y;
+        if (height > board->heights[point.x])
+            board->heights[point.x] = height;
+    }
+    board_mark_piece_dirty(board, piece);
 
-    // send Line Clear Packet to other board
-    packet_t line_clear_packet = {
-        .id = LINE_CLEAR_PACKET,
-        .data = lines_cleared,
-    };
-    packet_send(line_clear_packet);
+    return board_clear_lines(board);
 }
\ No newline at end of file
@@ -8,37 +8,98 @@
 #define BOARD_H
 
 #include <stdbool.h>
-#include <stdlib.h>
-#include <tinygl.h>
+#include <stdint.h>
 
 #include "piece.h"
 
-typedef struct {
-    bool tiles[TINYGL_WIDTH][TINYGL_HEIGHT];
+/** Size of the board, this matches the LED matrix of the UCFK4 */
+#define BOARD_WIDTH  5
+#define BOARD_HEIGHT 7
+
+/** Row mask with every tile in the row set, used to detect a full row */
+#define BOARD_FULL_ROW ((uint8_t)((1 << BOARD_WIDTH) - 1))
+
+/** Bit in a row mask representing the tile in column `x` */
+#define BOARD_TILE_BIT(x) ((uint8_t)(1 << (x)))
+
+/** Mask of every row of the board, used for `board_t.dirty_rows` */
+#define BOARD_ALL_ROWS ((uint8_t)((1 << BOARD_HEIGHT) - 1))
+
+/**
+ * The board is stored as a row-major bitboard.
+ * Each row is a single uint8_t mask, where bit `x` is set if the tile in column `x` is filled.
+ * Row 0 is the top of the LED display.
+ */
+typedef struct board {
+    uint8_t rows[BOARD_HEIGHT];
+
+    /**
+     * Height of the highest filled tile in each column, 0 if the column is empty and `BOARD_HEIGHT` if its top row is filled.
+     * Kept up to date as pieces are placed and lines cleared, so a piece's landing row can be found without simulating the drop.
+     */
+    uint8_t heights[BOARD_WIDTH];
+
+    /**
+     * Bit `y` is set if row `y` has changed since it was last drawn, either by a placed piece
+     * or by a piece moving on the board. The display only needs to redraw these rows.
+     */
+    uint8_t dirty_rows;
 } board_t;
 
 /**
- * @brief Initialises the board state
- * @param board Pass by reference `board` to be initialized
+ * @brief Initialises the board state, clearing all tiles.
+ * @param board The board to be initialised
+ */
+void board_init(board_t* board);
+
+/**
+ * @brief Mark the rows covered by the given piece as needing to be redrawn.
+ *        Inline, as this is called on every move of a piece.
+ */
+static inline void board_mark_piece_dirty(board_t* board, const piece_t* piece)
+{
+    uint8_t row_bits = pieces[piece->idx][piece->orientation].row_bits;
+    int8_t y = piece->pos.y;
+    board->dirty_rows |= (y >= 0 ? row_bits << y : row_bits >> -y) & BOARD_ALL_ROWS;
+}
+
+/**
+ * @brief Place the given tetris piece at its current position on the board, and clear any full rows.
+ * @param board The board to place the piece on.
+ * @param piece The piece to be placed on the board.
+ * @return The number of lines cleared by placing the piece.
+ */
+uint8_t board_place_piece(board_t* board, const piece_t* piece);
+
+/**
+ * @brief Checks and clears any rows that are full. Shifts the board's rows appropriately.
+ * @return uint8_t The number of lines cleared
+ */
+uint8_t board_clear_lines(board_t* board);
+
+/**
+ * @brief Recompute `heights` from the rows, for a board whose rows were set directly.
  */
-void board_init(board_t** board);
+void board_update_heights(board_t* board);
 
 /**
- * @brief Place the given tetris piece at its current position on the board
- * @param board The board to place the piece on. (`game_data->board`)
- * @param piece The piece to be placed on the board. (`game_data->piece`)
+ * @brief Returns the row the given piece would land on if it was dropped straight down from its current position.
+ *        Found from the column heights and the piece's bottom profile, checking at most 4 columns. Only when the
+ *        piece is below an overhang does it fall back to moving the piece down one row at a time.
+ * @param board The board to drop the piece on
+ * @param piece The piece to drop, must be at a valid position
  */
-void board_place_piece(board_t* board, piece_t* piece);
+int8_t board_landing_y(const board_t* board, const piece_t* piece);
 
 /**
  * @returns whether the given tetris piece, at the given coordinates and orientation, is at a valid position on the board.
  *          i.e. it does not collide with any placed pieces or extend outside the bounds of the LED display.
  *
- * @param board The global `board` object
+ * @param board The board to test against
  * @param piece The piece to check is valid
  * @param x The x coordinate of the piece to test
  * @param y The y coordinate of the piece to test
  * @param orientation The orientation of the piece to test
  */
-bool board_valid_position(board_t* board, piece_t* piece, uint8_t x, uint8_t y, orientation_t orientation);
+bool board_valid_position(const board_t* board, const piece_t* piece, int8_t x, int8_t y, orientation_t orientation);
 #endif  // BOARD_H
\ No newline at end of file
@@ -0,0 +1,323 @@
+/** @file engine.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Hardware independent tetris engine for a single player.
+ *         Has no dependency on the UCFK4 drivers, so it can be run headless on a host machine.
+ */
+
+#include "engine.h"
+
+/**
+ * Ticks it takes a piece to fall one row at each level, in `ENGINE_GRAVITY_ONE` fixed point.
+ * Follows the guideline speed curve of (0.8 - 0.007 * level)^level seconds per row, from 1 row per second at level 0.
+ * Levels faster than one row per tick fall several rows in a tick.
+ */
+static const uint16_t engine_gravity_table[ENGINE_NUM_LEVELS] = {
+    25600, 20301, 15816, 12102, 9093, 6707, 4856, 3449, 2403, 1642, 1100, 722, 465, 293, 181,
+};
+
+/**
+ * @brief Reset the engine to the start of a round, with an empty board and a newly spawned piece.
+ * @param engine The engine to be initialised
+ * @param seed Seed for the order of pieces, engines with the same seed spawn the same pieces.
+ */
+void engine_init(engine_t* engine, uint32_t seed)
+{
+    engine->state = ENGINE_STATE_PLAYING;
+    engine->seed = seed;
+    engine->lines_cleared = 0;
+    engine->pieces_spawned = 1;
+    engine->level = 0;
+    engine->start_level = 0;
+    engine->ticks = 0;
+    engine->gravity = 0;
+    engine->lock_delay = ENGINE_LOCK_DELAY;
+    engine->lock_resets = 0;
+    engine->spawn_delay = 0;
+    board_init(&engine->board);
+    piece_generator_init(&engine->generator, seed);
+    piece_generate_next(&engine->generator, &engine->board, &engine->current_piece);
+}
+
+/**
+ * @brief Start the round at a higher level, so pieces fall faster from the start.
+ *        Must be called straight after `engine_init`.
+ */
+void engine_set_start_level(engine_t* engine, uint8_t level)
+{
+    if (level >= ENGINE_NUM_LEVELS)
+        level = ENGINE_NUM_LEVELS - 1;
+
+    engine->start_level = level;
+    engine->level = level;
+}
+
+/**
+ * @brief Place the current piece on the board where it is, and wait for the next piece to be spawned.
+ */
+static void engine_lock(engine_t* engine, engine_event_t* event)
+{
+    event->piece_placed = true;
+    event->lines_cleared = board_place_piece(&engine->board, &engine->current_piece);
+    engine->lines_cleared += event->lines_cleared;
+
+    uint16_t level = engine->start_level + engine->lines_cleared / ENGINE_LINES_PER_LEVEL;
+    engine->level = level < ENGINE_NUM_LEVELS ? level : ENGINE_NUM_LEVELS - 1;
+
+    engine->state = ENGINE_STATE_SPAWNING;
+    engine->spawn_delay = ENGINE_SPAWN_DELAY;
+}
+
+/**
+ * @brief Spawn the next piece, or end the round if it doesn't fit.
+ */
+static void engine_spawn(engine_t* engine, engine_event_t* event)
+{
+    engine->state = ENGINE_STATE_PLAYING;
+    engine->gravity = 0;
+    engine->lock_delay = ENGINE_LOCK_DELAY;
+    engine->lock_resets = 0;
+
+    // next piece was not able to be spawned, so we have died.
+    bool valid_pos = piece_generate_next(&engine->generator, &engine->board, &engine->current_piece);
+    engine->pieces_spawned++;
+    if (!valid_pos)
+    {
+        engine->state = ENGINE_STATE_DEAD;
+        event->died = true;
+    }
+}
+
+/**
+ * @brief Move the current piece straight down to where it lands.
+ * @return Whether the piece was moved.
+ */
+static bool engine_hard_drop(engine_t* engine)
+{
+    piece_t* piece = &engine->current_piece;
+    int8_t landing_y = board_landing_y(&engine->board, piece);
+    if (landing_y == piece->pos.y)
+        return false;
+
+    // redraw the rows the piece has left, and the rows it now covers
+    board_mark_piece_dirty(&engine->board, piece);
+    piece->pos.y = landing_y;
+    board_mark_piece_dirty(&engine->board, piece);
+    return true;
+}
+
+/**
+ * @brief Restart the lock delay after the current piece has been moved or rotated while resting on the stack,
+ *        up to `ENGINE_MAX_LOCK_RESETS` times per piece.
+ */
+static void engine_reset_lock_delay(engine_t* engine)
+{
+    if (engine->lock_delay == 0 || engine->lock_delay == ENGINE_LOCK_DELAY || engine->lock_resets == ENGINE_MAX_LOCK_RESETS)
+        return;
+
+    engine->lock_delay = ENGINE_LOCK_DELAY;
+    engine->lock_resets++;
+}
+
+/**
+ * @brief Apply an input to the current piece.
+ * @return Whether the piece was moved/rotated.
+ */
+bool engine_input(engine_t* engine, engine_input_t input)
+{
+    // a hard dropped piece can't be moved before it is locked
+    if (engine->state != ENGINE_STATE_PLAYING || engine->lock_delay == 0)
+        return false;
+
+    bool was_moved;
+    switch (input)
+    {
+    case ENGINE_INPUT_LEFT:
+        was_moved = piece_move(&engine->board, &engine->current_piece, DIRECTION_LEFT);
+        break;
+
+    case ENGINE_INPUT_RIGHT:
+        was_moved = piece_move(&engine->board, &engine->current_piece, DIRECTION_RIGHT);
+        break;
+
+    case ENGINE_INPUT_DOWN:
+        return piece_move(&engine->board, &engine->current_piece, DIRECTION_DOWN);
+
+    case ENGINE_INPUT_ROTATE:
+        was_moved = piece_rotate(&engine->board, &engine->current_piece, true);
+        break;
+
+    case ENGINE_INPUT_ROTATE_CCW:
+        was_moved = piece_rotate(&engine->board, &engine->current_piece, false);
+        break;
+
+    case ENGINE_INPUT_DROP:
+        // locked by the next update, even if the piece was already resting on the stack
+        engine->lock_delay = 0;
+        return engine_hard_drop(engine);
+
+    case ENGINE_INPUT_NONE:
+    default:
+        return false;
+    }
+
+    if (was_moved)
+        engine_reset_lock_delay(engine);
+
+    return was_moved;
+}
+
+/**
+ * @brief Advance the game by one gravity step. Moves the current piece down, or places it
+ *        on the board and spawns the next piece if it cannot move down.
+ * @return What happened during this step.
+ */
+engine_event_t engine_tick(engine_t* engine)
+{
+    engine_event_t event = {0};
+    if (engine->state != ENGINE_STATE_PLAYING)
+        return event;
+
+    bool was_moved = piece_move(&engine->board, &engine->current_piece, DIRECTION_DOWN);
+    if (was_moved)
+        return event;
+
+    // the piece was not able to be moved down, so place the piece on the board at the current location
+    engine_lock(engine, &event);
+    engine_spawn(engine, &event);
+    return event;
+}
+
+/**
+ * @brief Advance the game by one tick in real time, must be called at `ENGINE_TICK_FREQ`.
+ *        The current piece falls at the speed of the current level, and is locked once it has rested
+ *        on the stack for the lock delay. The next piece is spawned after the spawn delay.
+ * @return What happened during this tick.
+ */
+engine_event_t engine_update(engine_t* engine)
+{
+    engine_event_t event = {0};
+    if (engine->state == ENGINE_STATE_DEAD)
+        return event;
+
+    engine->ticks++;
+    if (engine->state == ENGINE_STATE_SPAWNING)
+    {
+        if (--engine->spawn_delay == 0)
+            engine_spawn(engine, &event);
+        return event;
+    }
+
+    // hard dropped
+    piece_t* piece = &engine->current_piece;
+    if (engine->lock_delay == 0)
+    {
+        engine_lock(engine, &event);
+        return event;
+    }
+
+    // fall a row for every whole row's worth of ticks, which can be more than one row per tick
+    uint16_t ticks_per_row = engine_gravity_table[engine->level];
+    engine->gravity += ENGINE_GRAVITY_ONE;
+    while (engine->gravity >= ticks_per_row)
+    {
+        engine->gravity -= ticks_per_row;
+        if (!piece_move(&engine->board, piece, DIRECTION_DOWN))
+        {
+            // resting on the stack, the piece starts falling again straight away if it is moved off the edge
+            engine->gravity = ticks_per_row;
+            break;
+        }
+    }
+
+    // the lock delay only counts down while the piece is resting on the stack, and starts again once it falls
+    bool resting = !board_valid_position(&engine->board, piece, piece->pos.x, piece->pos.y + 1, piece->orientation);
+    if (!resting)
+        engine->lock_delay = ENGINE_LOCK_DELAY;
+    else if (--engine->lock_delay == 0)
+        engine_lock(engine, &event);
+
+    return event;
+}
+
+/**
+ * @brief Returns the number of ticks from now that `engine_update` would only count down the gravity and delays,
+ *        before the piece falls, is locked or spawns.
+ * @param resting Whether the current piece is resting on the stack.
+ */
+static uint32_t engine_idle_ticks(const engine_t* engine, bool resting)
+{
+    if (engine->state == ENGINE_STATE_SPAWNING)
+        return engine->spawn_delay - 1;
+
+    // hard dropped, locked by the next update
+    if (engine->lock_delay == 0)
+        return 0;
+
+    if (resting)
+        return engine->lock_delay - 1;
+
+    // ticks before the gravity reaches a whole row
+    uint16_t ticks_per_row = engine_gravity_table[engine->level];
+    if (engine->gravity >= ticks_per_row)
+        return 0;
+
+    return (ticks_per_row - engine->gravity - 1) / ENGINE_GRAVITY_ONE;
+}
+
+/**
+ * @brief Advance the game with no inputs until `tick` updates have been made this round, or the round ends.
+ *        The same as calling `engine_update` until then, but the ticks where only the gravity and delays
+ *        count down are skipped in bulk, so a replay can be played back quickly.
+ */
+void engine_update_until(engine_t* engine, uint32_t tick)
+{
+    while (engine->ticks < tick && engine->state != ENGINE_STATE_DEAD)
+    {
+        const piece_t* piece = &engine->current_piece;
+        bool spawning = engine->state == ENGINE_STATE_SPAWNING;
+        bool resting = !spawning && !board_valid_position(&engine->board, piece, piece->pos.x, piece->pos.y + 1, piece->orientation);
+
+        uint32_t idle = engine_idle_ticks(engine, resting);
+        if (idle > tick - engine->ticks)
+            idle = tick - engine->ticks;
+
+        engine->ticks += idle;
+        if (spawning)
+            engine->spawn_delay -= idle;
+        else if (resting)
+        {
+            // resting on the stack, once the gravity reaches a row it is held there by each failed move down
+            uint16_t ticks_per_row = engine_gravity_table[engine->level];
+            uint32_t gravity = engine->gravity + idle * ENGINE_GRAVITY_ONE;
+            engine->gravity = gravity >= ticks_per_row ? ticks_per_row : gravity;
+            engine->lock_delay -= idle;
+        }
+        else if (idle)
+        {
+            engine->gravity += idle * ENGINE_GRAVITY_ONE;
+            engine->lock_delay = ENGINE_LOCK_DELAY;
+        }
+
+        // the tick where something happens
+        if (engine->ticks < tick)
+            engine_update(engine);
+    }
+}
+
+/**
+ * @brief Returns the row the current piece would land on if it was hard dropped, used to draw the ghost piece.
+ */
+int8_t engine_landing_y(const engine_t* engine)
+{
+    return board_landing_y(&engine->board, &engine->current_piece);
+}
+
+/**
+ * @brief Returns the index into the `pieces` array of an upcoming piece, e.g. to show a preview of the next piece.
+ * @param ahead How far ahead to look, 0 is the piece spawned after the current piece. Must be less than `PIECE_LOOKAHEAD`.
+ */
+uint8_t engine_peek_next(engine_t* engine, uint8_t ahead)
+{
+    return piece_generator_peek(&engine->generator, ahead);
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+/** @file engine.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Hardware independent tetris engine for a single player.
+ *         Has no dependency on the UCFK4 drivers, so it can be run headless on a host machine.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "piece.h"
+
+/** Rate that `engine_update` is called at (in Hz), the gravity, lock and spawn delays are counted in these ticks */
+#define ENGINE_TICK_FREQ 100
+
+/** One tick in the 8.8 fixed point that gravity is counted in, so pieces can fall more than one row per tick */
+#define ENGINE_GRAVITY_ONE 256
+
+/** Number of levels, the level goes up every `ENGINE_LINES_PER_LEVEL` lines cleared and stops at the last level */
+#define ENGINE_NUM_LEVELS      15
+#define ENGINE_LINES_PER_LEVEL 5
+
+/** Ticks a piece can rest on the stack before it is locked in place (0.5s) */
+#define ENGINE_LOCK_DELAY 50
+
+/** Times moving or rotating a resting piece can restart its lock delay, so a piece can't be kept up forever */
+#define ENGINE_MAX_LOCK_RESETS 15
+
+/** Ticks between a piece being locked and the next piece spawning (0.2s) */
+#define ENGINE_SPAWN_DELAY 20
+
+/**
+ * Inputs that can be applied to the current piece.
+ */
+typedef enum {
+    ENGINE_INPUT_NONE,
+    ENGINE_INPUT_LEFT,
+    ENGINE_INPUT_RIGHT,
+    ENGINE_INPUT_DOWN,
+    ENGINE_INPUT_ROTATE,
+
+    /** hard drop, moves the piece straight down to where it lands. It is placed by the next `engine_tick` or `engine_update` */
+    ENGINE_INPUT_DROP,
+
+    /** rotate counter-clockwise, `ENGINE_INPUT_ROTATE` is clockwise */
+    ENGINE_INPUT_ROTATE_CCW,
+} engine_input_t;
+
+typedef enum {
+    /** A piece is being controlled */
+    ENGINE_STATE_PLAYING,
+
+    /** A piece has been locked, the next piece spawns once `spawn_delay` runs out */
+    ENGINE_STATE_SPAWNING,
+
+    /** A new piece could not be spawned, the round is over */
+    ENGINE_STATE_DEAD,
+} engine_state_t;
+
+/**
+ * Describes what happened during a call to `engine_tick` or `engine_update`, so the caller can react to it
+ * (e.g. sending a Line Clear packet).
+ */
+typedef struct {
+    /** the current piece could not move down and was placed on the board */
+    bool piece_placed;
+
+    /** the number of lines cleared by placing the piece */
+    uint8_t lines_cleared;
+
+    /** the next piece could not be spawned, we have died */
+    bool died;
+} engine_event_t;
+
+/**
+ * The state of a single player's game. Everything the engine needs is stored here,
+ * so multiple engines can be run side by side.
+ */
+typedef struct {
+    /** the current state of the round */
+    engine_state_t state;
+
+    /** the seed this round was initialised with */
+    uint32_t seed;
+
+    /** the tetris board/grid */
+    board_t board;
+
+    /** the current tetris piece being placed/controlled */
+    piece_t current_piece;
+
+    /** chooses the order that pieces are spawned in, and queues the upcoming pieces (see `engine_peek_next`) */
+    piece_generator_t generator;
+
+    /** the total number of lines cleared this round */
+    uint16_t lines_cleared;
+
+    /** the number of pieces spawned this round, including the current piece */
+    uint16_t pieces_spawned;
+
+    /** the current level, sets how fast pieces fall. Derived from `lines_cleared`, starting from `start_level` */
+    uint8_t level;
+    uint8_t start_level;
+
+    /** number of `engine_update` calls this round */
+    uint32_t ticks;
+
+    /** ticks the current piece has been falling since it last moved down a row, in `ENGINE_GRAVITY_ONE` fixed point */
+    uint16_t gravity;
+
+    /**
+     * Ticks left before the current piece is locked, only counts down while it is resting on the stack.
+     * 0 if it was hard dropped, so it is locked by the next update.
+     */
+    uint8_t lock_delay;
+
+    /** times the lock delay has been restarted for the current piece, up to `ENGINE_MAX_LOCK_RESETS` */
+    uint8_t lock_resets;
+
+    /** ticks left before the next piece spawns, while in `ENGINE_STATE_SPAWNING` */
+    uint8_t spawn_delay;
+} engine_t;
+
+/**
+ * @brief Reset the engine to the start of a round, with an empty board and a newly spawned piece.
+ * @param engine The engine to be initialised
+ * @param seed Seed for the order of pieces, engines with the same seed spawn the same pieces.
+ */
+void engine_init(engine_t* engine, uint32_t seed);
+
+/**
+ * @brief Start the round at a higher level, so pieces fall faster from the start.
+ *        Must be called straight after `engine_init`.
+ */
+void engine_set_start_level(engine_t* engine, uint8_t level);
+
+/**
+ * @brief Apply an input to the current piece.
+ * @return Whether the piece was moved/rotated.
+ */
+bool engine_input(engine_t* engine, engine_input_t input);
+
+/**
+ * @brief Advance the game by one gravity step, ignoring the level and delays. Moves the current piece down,
+ *        or places it on the board and spawns the next piece straight away if it cannot move down.
+ *        Used to play as fast as possible, a round must use either this or `engine_update`, not both.
+ * @return What happened during this step.
+ */
+engine_event_t engine_tick(engine_t* engine);
+
+/**
+ * @brief Advance the game by one tick in real time, must be called at `ENGINE_TICK_FREQ`.
+ *        The current piece falls at the speed of the current level, and is locked once it has rested
+ *        on the stack for the lock delay. The next piece is spawned after the spawn delay.
+ * @return What happened during this tick.
+ */
+engine_event_t engine_update(engine_t* engine);
+
+/**
+ * @brief Advance the game with no inputs until `tick` updates have been made this round, or the round ends.
+ *        The same as calling `engine_update` until then, but the ticks where only the gravity and delays
+ *        count down are skipped in bulk, so a replay can be played back quickly.
+ */
+void engine_update_until(engine_t* engine, uint32_t tick);
+
+/**
+ * @brief Returns the row the current piece would land on if it was hard dropped, used to draw the ghost piece.
+ */
+int8_t engine_landing_y(const engine_t* engine);
+
+/**
+ * @brief Returns the index into the `pieces` array of an upcoming piece, e.g. to show a preview of the next piece.
+ * @param ahead How far ahead to look, 0 is the piece spawned after the current piece. Must be less than `PIECE_LOOKAHEAD`.
+ */
+uint8_t engine_peek_next(engine_t* engine, uint8_t ahead);
+
+#endif  // ENGINE_H
\ No newline at end of file
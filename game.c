@@ -5,35 +5,299 @@
  */
 
 #include <stdbool.h>
+#include <stdlib.h>
 
+#include "ai.h"
 #include "board.h"
 #include "game_data.h"
 #include "packet.h"
 #include "piece.h"
+#include "replay.h"
+#include "task_stats.h"
 
 // API headers
 #include <button.h>
 #include <font5x7_1.h>
 #include <ir_uart.h>
 #include <led.h>
+#include <ledmat.h>
 #include <navswitch.h>
 #include <system.h>
 #include <task.h>
+#include <timer.h>
 #include <tinygl.h>
 
 // Task frequency (in Hz)
-#define BUTTON_TASK_FREQ      100  // 1/10  -> 10ms
+#define BUTTON_TASK_FREQ      100  // 1/100 -> 10ms, also advances the game by one tick
 #define DISPLAY_TASK_FREQ     300  // 1/300 -> 3.33ms
 #define IR_TASK_FREQ          100  // 1/100 -> 10ms
+#define IR_TX_TASK_FREQ       250  // 1/250 -> 4ms, about the time to send one byte at 2400 baud
 #define LED_FLASH_TASK_FREQ   8    // 1/8   -> 125ms
-#define BOARD_MOVE_DOWN_FREQ  1    // 1/1   -> 1s
-#define SEND_PACKET_TASK_FREQ 2    // 1/2   -> 500ms
+#define SEND_PACKET_TASK_FREQ 10   // 1/10  -> 100ms, how often the heartbeat and link timeout are checked
 
 // Constants
 #define TINYGL_SPEED 25
 
+// Runs of the button task the push button must be held down for to preview the next piece,
+// instead of rotating counter-clockwise when it is released (250ms)
+#define BUTTON_HOLD_TICKS (BUTTON_TASK_FREQ / 4)
+
+#if BOARD_WIDTH != TINYGL_WIDTH || BOARD_HEIGHT != TINYGL_HEIGHT
+#error "The board must be the same size as the LED matrix"
+#endif
+
+#if BUTTON_TASK_FREQ != ENGINE_TICK_FREQ
+#error "The engine is updated once per run of the button task"
+#endif
+
+#if IR_TASK_FREQ != PACKET_TICK_FREQ
+#error "The packet link's clock is advanced once per run of the IR task"
+#endif
+
+// The link to the other board, over IR
+static packet_link_t ir_link;
+
+#ifdef REPLAY_RECORD
+
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#else
+#include <stdio.h>
+#endif
+
+// Size of the buffer each round is recorded into, the round is only saved if it fits
+#ifndef REPLAY_BUFFER_SIZE
+#define REPLAY_BUFFER_SIZE 192
+#endif
+
+// The replay is saved to EEPROM at this address, as a uint16_t length followed by the replay
+#define REPLAY_EEPROM_ADDR 0
+
+static replay_t replay;
+static uint8_t replay_buffer[REPLAY_BUFFER_SIZE];
+
+/**
+ * @brief Finish recording the round, and save it to EEPROM (or `replay.bin` on the host).
+ */
+static void replay_save(void)
+{
+    uint16_t len = replay_finish(&replay, &game_data->engine);
+    if (len == 0)
+        return;
+
+#ifdef __AVR__
+    eeprom_update_block(&len, (void*)REPLAY_EEPROM_ADDR, sizeof(len));
+    eeprom_update_block(replay_buffer, (void*)(REPLAY_EEPROM_ADDR + sizeof(len)), len);
+#else
+    FILE* file = fopen("replay.bin", "wb");
+    if (file)
+    {
+        fwrite(replay_buffer, 1, len, file);
+        fclose(file);
+    }
+#endif
+}
+
+#endif  // REPLAY_RECORD
+
+/** Runs of the button task the push button has been held down for (up to `BUTTON_HOLD_TICKS`), 0 when it isn't down */
+static uint8_t button_hold_ticks = 0;
+
+#ifdef AI_AUTOPLAY
+// The computer player that plays this board instead of the nav switch
+static ai_t ai;
+#endif
+
+/**
+ * @brief Reset the game data for a new round.
+ */
+static void game_reset(void)
+{
+    // randomise the prng seed
+    srand(timer_get());
+    game_data_reset();
+}
+
+/**
+ * @brief Start playing the round once the countdown has finished, and start recording it.
+ */
+static void game_start(void)
+{
+    game_data_start_round();
+    game_data->game_state = GAME_STATE_PLAYING;
+    button_hold_ticks = 0;
+
+#ifdef REPLAY_RECORD
+    replay_start(&replay, replay_buffer, sizeof(replay_buffer), &game_data->engine);
+#endif
+
+#ifdef AI_AUTOPLAY
+    ai_init(&ai, NULL, 0, 0);
+#endif
+}
+
+/**
+ * @brief Apply an input to our current piece, and record it.
+ */
+static void game_input(engine_input_t input)
+{
+    if (input == ENGINE_INPUT_NONE)
+        return;
+
+    engine_input(&game_data->engine, input);
+
+#ifdef REPLAY_RECORD
+    replay_record(&replay, (replay_code_t)input, &game_data->engine);
+#endif
+}
+
+/**
+ * @brief Advance our game by one tick, moving the current piece down at the speed of our level and locking it
+ *        once it has come to rest. Records the tick, and tells the other board when we clear lines or die.
+ */
+static void game_update(void)
+{
+    engine_event_t event = engine_update(&game_data->engine);
+
+#ifdef REPLAY_RECORD
+    replay_update(&replay, &game_data->engine);
+#endif
+
+    // tell the other board when we clear lines or die
+    handle_engine_event(event);
+
+#ifdef REPLAY_RECORD
+    if (event.died)
+        replay_save();
+#endif
+}
+
+/**
+ * Column bitmaps of the board and the current piece, in the layout used by the LED matrix driver.
+ * Bit `y` of `frame[x]` is set if the LED at (`x`, `y`) is on.
+ */
+static uint8_t frame[BOARD_WIDTH];
+
+/** Column bitmaps of the ghost piece, where the current piece would land. Shown on every other refresh, so it is dimmer */
+static uint8_t ghost[BOARD_WIDTH];
+
+/** Whether the next piece is shown instead of the board, while the push button is held */
+static bool show_preview = false;
+
+/**
+ * @brief Set row `y` of `columns` (`frame` or `ghost`) to `row`, in the layout used by `board_t.rows`.
+ */
+static void frame_set_row(uint8_t* columns, uint8_t y, uint8_t row)
+{
+    // transpose the row into bit `y` of each column
+    for (uint8_t x = 0; x < BOARD_WIDTH; x++, row >>= 1)
+        columns[x] = (columns[x] & ~(1 << y)) | ((row & 1) << y);
+}
+
+/**
+ * @brief Updates the rows of `frame` that have changed since they were last composed,
+ *        from the board's rows and the current piece's row masks. Redraws `ghost` if anything has changed.
+ * @param redraw_all Recompose every row, e.g. when the display was previously showing text.
+ */
+static void frame_compose(engine_t* engine, bool redraw_all)
+{
+    board_t* board = &engine->board;
+    if (redraw_all)
+        board->dirty_rows = BOARD_ALL_ROWS;
+
+    uint8_t dirty = board->dirty_rows;
+    board->dirty_rows = 0;
+    if (!dirty)
+        return;
+
+    // the ghost can move to any row when the piece or board changes, so it is always redrawn in full
+    piece_t landed = engine->current_piece;
+    landed.pos.y = engine_landing_y(engine);
+
+    // there is no current piece while waiting for the next piece to spawn
+    bool has_piece = engine->state == ENGINE_STATE_PLAYING;
+
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++, dirty >>= 1)
+    {
+        uint8_t piece_row = has_piece ? piece_row_mask(&engine->current_piece, y) : 0;
+        frame_set_row(ghost, y, has_piece ? piece_row_mask(&landed, y) & ~piece_row : 0);
+
+        if (dirty & 1)
+            frame_set_row(frame, y, board->rows[y] | piece_row);
+    }
+}
+
+/**
+ * @brief Compose the next piece into `frame` in place of the board, in the middle of the screen.
+ *        Only recomposed when the board has changed, as the next piece changes when a piece is placed.
+ * @param redraw_all Recompose the frame even if nothing has changed, e.g. when the display was previously showing the board.
+ */
+static void frame_compose_preview(engine_t* engine, bool redraw_all)
+{
+    if (!redraw_all && !engine->board.dirty_rows)
+        return;
+
+    // the board is redrawn in full once the preview is hidden
+    engine->board.dirty_rows = 0;
+
+    piece_t next = {
+        .idx = engine_peek_next(engine, 0),
+        .pos = {.x = 1, .y = 2},
+        .orientation = ORIENTATION_NORTH,
+    };
+
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+    {
+        frame_set_row(frame, y, piece_row_mask(&next, y));
+        frame_set_row(ghost, y, 0);
+    }
+}
+
+/**
+ * @brief Displays the next column of `frame` on the LED matrix.
+ *        Like `tinygl_update`, one column is shown per call, so this must be called at `DISPLAY_TASK_FREQ`.
+ */
+static void frame_display(void)
+{
+    static uint8_t column = 0;
+    static bool show_ghost = false;
+    ledmat_display_column(show_ghost ? frame[column] | ghost[column] : frame[column], column);
+
+    column++;
+    if (column == BOARD_WIDTH)
+    {
+        column = 0;
+        show_ghost = !show_ghost;
+    }
+}
+
+#ifndef AI_AUTOPLAY
+/**
+ * @brief Handle the push button while playing. Tapping it rotates the current piece counter-clockwise when it is released,
+ *        holding it down for `BUTTON_HOLD_TICKS` previews the next piece until it is released.
+ */
+static void game_button_input(void)
+{
+    if (button_down_p(BUTTON1))
+    {
+        if (button_hold_ticks < BUTTON_HOLD_TICKS)
+            button_hold_ticks++;
+    }
+    else
+    {
+        // released before it was held long enough to preview
+        if (button_hold_ticks && button_hold_ticks < BUTTON_HOLD_TICKS)
+            game_input(ENGINE_INPUT_ROTATE_CCW);
+        button_hold_ticks = 0;
+    }
+
+    show_preview = button_hold_ticks >= BUTTON_HOLD_TICKS;
+}
+#endif  // AI_AUTOPLAY
+
 /**
- * Task to poll and handle the push button and nav switch controls
+ * Task to poll and handle the push button and nav switch controls, and advance the game by one tick.
+ * The game runs at the rate of this task, rather than having a task for gravity, so pieces can fall faster than any task period.
  */
 static void button_task(__unused__ void* data)
 {
@@ -44,36 +308,48 @@ static void button_task(__unused__ void* data)
     {
     case GAME_STATE_MAIN_MENU:
         {
+            // Report how long each task is taking (only when built with TASK_STATS).
+            // Only before pairing, as it blocks while it is sent over the IR link the packets use.
+            if (button_push_event_p(BUTTON1))
+                task_stats_dump();
+
             // Send pairing packet on nav push
             // the other board should respond with PairingAck, then the game will commence.
             if (navswitch_push_event_p(NAVSWITCH_PUSH))
-            {
-                packet_t pairing_packet = {
-                    .id = PAIRING_PACKET,
-                    .data = game_data->rng_seed,
-                };
-                packet_send(pairing_packet);
-                game_data->host = true;
-            }
+                send_pairing_packet();
             return;
         }
 
     case GAME_STATE_PLAYING:
         {
-            // Rotate piece
+#ifdef AI_AUTOPLAY
+            // one input per tick, chosen by the computer player
+            game_input(ai_next_input(&ai, &game_data->engine));
+#else
+            // Rotate piece clockwise
             if (navswitch_push_event_p(NAVSWITCH_PUSH))
-                piece_rotate(game_data->current_piece);
+                game_input(ENGINE_INPUT_ROTATE);
 
             // Move current piece
             if (navswitch_push_event_p(NAVSWITCH_EAST))
-                piece_move(game_data->current_piece, DIRECTION_RIGHT);
+                game_input(ENGINE_INPUT_RIGHT);
 
             if (navswitch_push_event_p(NAVSWITCH_WEST))
-                piece_move(game_data->current_piece, DIRECTION_LEFT);
+                game_input(ENGINE_INPUT_LEFT);
 
             if (navswitch_push_event_p(NAVSWITCH_SOUTH))
-                piece_move(game_data->current_piece, DIRECTION_DOWN);
+                game_input(ENGINE_INPUT_DOWN);
+
+            // Hard drop, the piece is locked by the update below
+            if (navswitch_push_event_p(NAVSWITCH_NORTH))
+                game_input(ENGINE_INPUT_DROP);
+
+            // Rotate piece counter-clockwise, or preview the next piece
+            game_button_input();
+#endif
 
+            // Gravity, lock and spawn delays
+            game_update();
             return;
         }
 
@@ -81,7 +357,7 @@ static void button_task(__unused__ void* data)
         {
             // Restart game, reinitialise data
             if (navswitch_push_event_p(NAVSWITCH_PUSH))
-                game_data_init();
+                game_reset();
         }
 
     default:
@@ -127,7 +403,7 @@ static void display_task(__unused__ void* data)
                 tinygl_text("1");
             else if (ticks == DISPLAY_TASK_FREQ * 3)
             {
-                game_data->game_state = GAME_STATE_PLAYING;
+                game_start();
                 ticks = 0;
                 tinygl_text_mode_set(TINYGL_TEXT_MODE_SCROLL);
                 return;  // don't increase ticks below, since we want to reset here
@@ -139,23 +415,17 @@ static void display_task(__unused__ void* data)
 
     case GAME_STATE_PLAYING:
         {
-            tinygl_clear();
-
-            // draw placed board points
-            for (int8_t x = 0; x < TINYGL_WIDTH; x++)
-            {
-                for (int8_t y = 0; y < TINYGL_HEIGHT; y++)
-                {
-                    if (game_data->board->tiles[x][y])
-                    {
-                        tinygl_point_t point = {x, y};
-                        tinygl_draw_point(point, 1);
-                    }
-                }
-            }
-
-            piece_draw(game_data->current_piece);
-            break;
+            // only recompose what has changed, everything is recomposed when coming from another screen or the preview
+            static bool preview_shown = false;
+            if (show_preview)
+                frame_compose_preview(&game_data->engine, state_changed || !preview_shown);
+            else
+                frame_compose(&game_data->engine, state_changed || preview_shown);
+            preview_shown = show_preview;
+
+            // the frame is sent straight to the LED matrix, bypassing tinygl
+            frame_display();
+            return;
         }
 
     case GAME_STATE_DEAD:
@@ -175,9 +445,9 @@ static void display_task(__unused__ void* data)
             {
                 tinygl_clear();
 
-                if (game_data->our_lines_cleared > game_data->their_lines_cleared)
+                if (game_data->engine.lines_cleared > game_data->their_lines_cleared)
                     tinygl_text(" WIN");
-                else if (game_data->our_lines_cleared < game_data->their_lines_cleared)
+                else if (game_data->engine.lines_cleared < game_data->their_lines_cleared)
                     tinygl_text(" LOSE");
                 else
                     tinygl_text(" DRAW");
@@ -207,48 +477,20 @@ static void display_task(__unused__ void* data)
 }
 
 /**
- * Used to move the current piece down automatically. Will place the piece on
- * the board if there is nowhere to move down, and will spawn the next piece to be placed.
+ * Task to handle any IR packets that have been received, then send every packet queued since the last run as one frame.
  */
-static void board_move_down_task(__unused__ void* data)
+static void ir_update_task(__unused__ void* data)
 {
-    if (game_data->game_state != GAME_STATE_PLAYING)
-        return;
-
-    // Detect when a new piece has been spawned, skip moving for this iteration
-    // so the piece isn't moved down immediately as soon as it's spawned
-    static piece_t* old_piece = 0;
-    if (old_piece != game_data->current_piece)
-    {
-        old_piece = game_data->current_piece;
-        return;
-    }
-
-    bool was_moved = piece_move(game_data->current_piece, DIRECTION_DOWN);
-
-    // the piece was not able to be moved down, so place the piece on the board at the currenet location
-    if (!was_moved)
-    {
-        board_place_piece(game_data->board, game_data->current_piece);
-        bool valid_pos = piece_generate_next(&game_data->current_piece);
-
-        // next piece was not able to be spawned, so we have died.
-        if (!valid_pos)
-            game_data->game_state = GAME_STATE_DEAD;
-    }
+    // drain the IR receiver, then handle every packet that has arrived
+    packet_process();
 }
 
 /**
- * Task to handle any IR packets that have been received.
+ * Task to write the frames waiting to be sent to the IR transmitter, without waiting for it to be ready.
  */
-static void ir_update_task(__unused__ void* data)
+static void ir_tx_task(__unused__ void* data)
 {
-    packet_t packet;
-    bool recvd_packet = packet_get(&packet);
-    if (!recvd_packet)
-        return;
-
-    handle_packet(packet);
+    packet_transmit();
 }
 
 /**
@@ -267,7 +509,7 @@ static void led_flash_task(__unused__ void* data)
     }
 
     // Check if the other player has cleared more lines since the last time this task ran
-    static uint8_t num_flashed = 0;
+    static uint16_t num_flashed = 0;
     if (num_flashed < game_data->their_lines_cleared)
     {
         led_set(LED1, true);
@@ -280,13 +522,8 @@ static void led_flash_task(__unused__ void* data)
  */
 static void send_packet_task(__unused__ void* data)
 {
-    // Send die packet, and check if the game is over
-    check_die_packet();
-    game_data_check_game_over();
-
-    // Ping / Pong functionality
-    check_ping_pong_packet();
-    game_data_check_pause();
+    // game over, Ping / Pong and pausing, and our Die packet if it couldn't be queued when we died
+    check_packets();
 }
 
 /**
@@ -297,6 +534,7 @@ static inline void environment_init(void)
     // misc api
     system_init();
     ir_uart_init();
+    packet_init(&ir_link, &ir_transport);
     timer_init();
     button_init();
 
@@ -314,19 +552,30 @@ static inline void environment_init(void)
 int main(void)
 {
     environment_init();
-    game_data_init();
+    game_reset();
 
     // Run tasks
     task_t tasks[] =
         {
             {.func = display_task,         .period = TASK_RATE / DISPLAY_TASK_FREQ    },
             {.func = button_task,          .period = TASK_RATE / BUTTON_TASK_FREQ     },
-            {.func = board_move_down_task, .period = TASK_RATE / BOARD_MOVE_DOWN_FREQ },
             {.func = ir_update_task,       .period = TASK_RATE / IR_TASK_FREQ         },
+            {.func = ir_tx_task,           .period = TASK_RATE / IR_TX_TASK_FREQ      },
             {.func = led_flash_task,       .period = TASK_RATE / LED_FLASH_TASK_FREQ  },
             {.func = send_packet_task,     .period = TASK_RATE / SEND_PACKET_TASK_FREQ}
     };
 
+    // Names of the tasks above, used by the task_stats report
+    static const char* const task_names[] = {
+        "display_task",
+        "button_task",
+        "ir_update_task",
+        "ir_tx_task",
+        "led_flash_task",
+        "send_packet_task",
+    };
+    task_stats_wrap(tasks, task_names, ARRAY_SIZE(tasks));
+
     task_schedule(tasks, ARRAY_SIZE(tasks));
     return 0;
 }
@@ -6,42 +6,42 @@
 
 #include "game_data.h"
 
+#include <stdlib.h>
+
 #include "packet.h"
-#include <string.h>
-#include <timer.h>
+
+/**
+ * The game state of the UCFK4, statically allocated so the heap allocator isn't linked in.
+ */
+static game_data_t game_data_storage;
 
 /**
  * Global variable of the game state.
  */
-game_data_t* game_data = NULL;
+game_data_t* game_data = &game_data_storage;
 
 /**
- * Initialise the global variable `game_data`.
+ * Reset the game state that `game_data` points to, back to the main menu with a new rng seed.
  */
-void game_data_init()
+void game_data_reset(void)
 {
-    // On first run we malloc the game_data pointer, and continue to reuse it for the rest of the program
-    static bool init = false;
-    if (!init)
-    {
-        game_data = malloc(sizeof(game_data_t));
-        memset(game_data, 0, sizeof(game_data_t));
-        init = true;
-    }
-
-    // randomise the prng seed
-    srand(timer_get());
-
+    // The host simulations point game_data at their own game_data_t for each board before resetting it.
     game_data->game_state = GAME_STATE_MAIN_MENU;
     game_data->host = false;
-    game_data->rng_seed = rand() % PACKET_DATA_MAX_VAL; // rng_seed needs to be networked (in PairingPacket), so can't be larger than packet data.
-    board_init(&game_data->board);
-    piece_generate_next(&game_data->current_piece);
-    game_data->our_lines_cleared = 0;
+    game_data->rng_seed = (uint32_t)rand() << 16 ^ rand(); // rand() may only give 15 bits, so combine two calls
+    engine_init(&game_data->engine, game_data->rng_seed);
     game_data->their_lines_cleared = 0;
-    game_data->die_packet_acknowledged = false;
     game_data->other_player_dead = false;
-    game_data->recvd_pingpong = true; // initialise with true so game doesn't immediately pause
+    game_data->die_queued = false;
+}
+
+/**
+ * Start the round, seeding the engine with `rng_seed` so both boards spawn the same pieces.
+ */
+void game_data_start_round(void)
+{
+    engine_init(&game_data->engine, game_data->rng_seed);
+    game_data->die_queued = false;
 }
 
 /**
@@ -55,23 +55,22 @@ void game_data_check_game_over(void)
 }
 
 /**
- * This function checks if the game should be paused, if this board has not received the
- * required ping or pong packet.
+ * This function checks if the game should be paused, if this board has not heard from the other board
+ * within the link timeout.
  */
 void game_data_check_pause(void)
 {
-    // The host will always send a Ping packet
-    // In handle_packet, we set `game_data->recv_pingpong` to true when a Ping/Pong packet has been received
+    // The host will always send a Ping packet, and the other board always responds with a Pong.
+    // The link timeout adapts to how reliable the link is, so a single lost Ping doesn't pause the game.
+    bool alive = packet_link_alive();
 
-    // Didn't recv a pingpong. Only if we are playing, pause the game.
-    if (!game_data->recvd_pingpong && game_data->game_state == GAME_STATE_PLAYING)
+    // Lost the other board. Only if we are playing, pause the game.
+    if (!alive && game_data->game_state == GAME_STATE_PLAYING)
         game_data->game_state = GAME_STATE_PAUSED;
 
-    // We did recv a pingpong. Unpause the game if we are currently paused
+    // We can hear the other board again. Unpause the game if we are currently paused
     // We only ever pause when we are playing, so unpause by setting state back to playing.
-    if (game_data->recvd_pingpong && game_data->game_state == GAME_STATE_PAUSED)
+    if (alive && game_data->game_state == GAME_STATE_PAUSED)
         game_data->game_state = GAME_STATE_PLAYING;
 
-    game_data->recvd_pingpong = false;
-
 }
\ No newline at end of file
@@ -7,8 +7,7 @@
 #ifndef GAME_DATA_H
 #define GAME_DATA_H
 
-#include "board.h"
-#include "piece.h"
+#include "engine.h"
 
 typedef enum {
     /** Main menu of the game, players need to pair before starting */
@@ -42,40 +41,37 @@ typedef struct {
      */
     bool host;
 
-    /** seed used to randomise the order of tetris pieces spawning */
-    uint8_t rng_seed;
+    /** seed used to randomise the order of tetris pieces spawning, shared with the other board when pairing */
+    uint32_t rng_seed;
 
-    /** the tetris board/grid */
-    board_t* board;
-
-    /** the current tetris piece being placed/controlled */
-    piece_t* current_piece;
-
-    /** the total number of lines we have cleared */
-    uint8_t our_lines_cleared;
+    /** our board, current piece and the total number of lines we have cleared */
+    engine_t engine;
 
     /** the total number of lines the other player has cleared */
-    uint8_t their_lines_cleared;
-
-    /** Used when we die to repeatedly sent the Die packet until the board sends the Ack packet */
-    bool die_packet_acknowledged;
+    uint16_t their_lines_cleared;
 
     /** Is the other player still alive/playing */
     bool other_player_dead;
 
-    /** whether the device has recieved a ping/pong packet from the other device */
-    bool recvd_pingpong;
+    /** Has our Die packet been queued, it waits for a free reliable packet slot after we die */
+    bool die_queued;
 } game_data_t;
 
 /**
  * Global variable of the game state.
+ * Points to static storage on the UCFK4, the host simulations point it at their own for each board.
  */
 extern game_data_t* game_data;
 
 /**
- * Initialise the global variable `game_data`.
+ * Reset the game state that `game_data` points to, back to the main menu with a new rng seed.
+ */
+void game_data_reset(void);
+
+/**
+ * Start the round, seeding the engine with `rng_seed` so both boards spawn the same pieces.
  */
-void game_data_init(void);
+void game_data_start_round(void);
 
 /**
  * This function checks if both players have died, and sets the game state to GAME_OVER.
@@ -83,8 +79,8 @@ void game_data_init(void);
 void game_data_check_game_over(void);
 
 /**
- * This function checks if the game should be paused, if this board has not received the
- * required ping or pong packet.
+ * This function checks if the game should be paused, if this board has not heard from the other board
+ * within the link timeout.
  */
 void game_data_check_pause(void);
 
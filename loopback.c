@@ -0,0 +1,126 @@
+/** @file loopback.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief In-process transport connecting two simulated boards on the host, in place of the IR link.
+ *         Models the time taken to send each byte and the latency of the link, and can lose or corrupt bytes.
+ */
+
+#include "loopback.h"
+
+#include <string.h>
+
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Returns true with the given probability.
+ */
+static bool loopback_chance(loopback_t* loopback, double probability)
+{
+    if (probability <= 0)
+        return false;
+
+    return (xorshift64(&loopback->rng) >> 11) * (1.0 / (UINT64_C(1) << 53)) < probability;
+}
+
+static bool loopback_read_ready(void* ctx)
+{
+    loopback_end_t* end = ctx;
+    loopback_t* loopback = end->loopback;
+
+    // read the bytes written by the other end
+    const loopback_channel_t* channel = &loopback->channels[!end->id];
+    return channel->head != channel->tail && channel->queue[channel->tail % LOOPBACK_QUEUE_SIZE].arrival <= loopback->now;
+}
+
+static uint8_t loopback_read(void* ctx)
+{
+    loopback_end_t* end = ctx;
+    loopback_channel_t* channel = &end->loopback->channels[!end->id];
+    return channel->queue[channel->tail++ % LOOPBACK_QUEUE_SIZE].byte;
+}
+
+static bool loopback_write_ready(void* ctx)
+{
+    loopback_end_t* end = ctx;
+    loopback_t* loopback = end->loopback;
+    const loopback_channel_t* channel = &loopback->channels[end->id];
+
+    // the previous byte is still being sent, or too many bytes are in flight
+    return channel->busy_until <= loopback->now && (uint16_t)(channel->head - channel->tail) < LOOPBACK_QUEUE_SIZE;
+}
+
+static void loopback_write(void* ctx, uint8_t byte)
+{
+    loopback_end_t* end = ctx;
+    loopback_t* loopback = end->loopback;
+    loopback_channel_t* channel = &loopback->channels[end->id];
+
+    channel->busy_until = loopback->now + loopback->config.byte_us;
+    channel->sent++;
+
+    // a lost byte still takes up the link while it is sent
+    if (loopback_chance(loopback, loopback->config.loss))
+    {
+        channel->lost++;
+        return;
+    }
+
+    if (loopback_chance(loopback, loopback->config.corruption))
+    {
+        byte ^= 1 << (xorshift64(&loopback->rng) % 8);
+        channel->corrupted++;
+    }
+
+    loopback_byte_t* in_flight = &channel->queue[channel->head++ % LOOPBACK_QUEUE_SIZE];
+    in_flight->byte = byte;
+    in_flight->arrival = channel->busy_until + loopback->config.latency_us;
+}
+
+/**
+ * @brief Initialise an empty link between two ends, at time 0.
+ */
+void loopback_init(loopback_t* loopback, const loopback_config_t* config)
+{
+    memset(loopback, 0, sizeof(loopback_t));
+    loopback->config = *config;
+    loopback->rng = config->seed | 1;
+
+    for (uint8_t id = 0; id < 2; id++)
+    {
+        loopback->ends[id] = (loopback_end_t) {
+            .loopback = loopback,
+            .id = id,
+        };
+
+        loopback->transports[id] = (transport_t) {
+            .read_ready = loopback_read_ready,
+            .read = loopback_read,
+            .write_ready = loopback_write_ready,
+            .write = loopback_write,
+            .ctx = &loopback->ends[id],
+        };
+    }
+}
+
+/**
+ * @brief Returns the transport used by end `id` (0 or 1) of the link.
+ */
+const transport_t* loopback_transport(loopback_t* loopback, uint8_t id)
+{
+    return &loopback->transports[id];
+}
+
+/**
+ * @brief Set the current time (in microseconds). Bytes are only received once their arrival time has passed.
+ */
+void loopback_set_time(loopback_t* loopback, uint64_t now)
+{
+    loopback->now = now;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+/** @file loopback.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief In-process transport connecting two simulated boards on the host, in place of the IR link.
+ *         Models the time taken to send each byte and the latency of the link, and can lose or corrupt bytes.
+ */
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "transport.h"
+
+// Maximum number of bytes in flight in each direction, must be a power of 2
+#define LOOPBACK_QUEUE_SIZE 256
+
+/** Behaviour of the simulated link, the same in both directions */
+typedef struct {
+    /** time taken to send one byte (in microseconds), 10 bits per byte at the baud rate */
+    uint32_t byte_us;
+
+    /** time from a byte being sent to it being received (in microseconds) */
+    uint32_t latency_us;
+
+    /** probability of each byte being lost */
+    double loss;
+
+    /** probability of one bit of each byte being flipped */
+    double corruption;
+
+    /** seed of the random number generator used for the loss and corruption */
+    uint64_t seed;
+} loopback_config_t;
+
+/** A byte in flight */
+typedef struct {
+    uint8_t byte;
+
+    /** the time it can be read by the other end */
+    uint64_t arrival;
+} loopback_byte_t;
+
+/** One direction of the link */
+typedef struct {
+    loopback_byte_t queue[LOOPBACK_QUEUE_SIZE];
+    uint16_t head;
+    uint16_t tail;
+
+    /** the time the last byte written has finished sending */
+    uint64_t busy_until;
+
+    /** number of bytes written, and how many of them were lost or corrupted */
+    uint64_t sent;
+    uint64_t lost;
+    uint64_t corrupted;
+} loopback_channel_t;
+
+typedef struct loopback loopback_t;
+
+/** One end of the link, the `ctx` of its transport */
+typedef struct {
+    loopback_t* loopback;
+    uint8_t id;
+} loopback_end_t;
+
+struct loopback {
+    loopback_config_t config;
+
+    /** the current time (in microseconds), set by the simulation */
+    uint64_t now;
+
+    uint64_t rng;
+
+    /** `channels[i]` carries the bytes written by end `i` */
+    loopback_channel_t channels[2];
+
+    loopback_end_t ends[2];
+    transport_t transports[2];
+};
+
+/**
+ * @brief Initialise an empty link between two ends, at time 0.
+ */
+void loopback_init(loopback_t* loopback, const loopback_config_t* config);
+
+/**
+ * @brief Returns the transport used by end `id` (0 or 1) of the link.
+ */
+const transport_t* loopback_transport(loopback_t* loopback, uint8_t id);
+
+/**
+ * @brief Set the current time (in microseconds). Bytes are only received once their arrival time has passed.
+ */
+void loopback_set_time(loopback_t* loopback, uint64_t now);
+
+#endif  // LOOPBACK_H
\ No newline at end of file
@@ -0,0 +1,540 @@
+/** @file match.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Two-player simulation harness, plays both boards of a match against each other in one process.
+ *
+ *  Each board runs the same multiplayer flow as game.c (pairing, countdown, line clears, ping/pong pausing, dying)
+ *  on its own `game_data_t` and `packet_link_t`, connected by a loopback transport instead of IR. The boards' tasks
+ *  are run at their real rates on a simulated clock, so many matches can be played per second. After both boards
+ *  reach the game over screen, each board's count of the other's lines must match what the other actually cleared,
+ *  and every reliable packet either board sent must have been handled by the other.
+ *
+ *  The boards share game.c's steps through `send_pairing_packet`, `handle_engine_event`, `packet_process` and
+ *  `check_packets` in packet.c, so only the player and the clock are simulated here.
+ *
+ *  Usage: ./match [-m matches] [-s seed] [-b baud] [-l latency_ms] [-x loss] [-c corruption] [-L level] [-D copies] [-a] [-v]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "game_data.h"
+#include "loopback.h"
+#include "packet.h"
+
+// Default settings
+#define MATCH_DEFAULT_MATCHES 1000
+#define MATCH_DEFAULT_SEED    1
+#define MATCH_DEFAULT_BAUD    2400
+#define MATCH_DEFAULT_LEVEL   0
+
+// Task rates (in Hz), the same as game.c
+#define MATCH_BUTTON_FREQ      100
+#define MATCH_IR_FREQ          PACKET_TICK_FREQ
+#define MATCH_IR_TX_FREQ       250
+#define MATCH_SEND_PACKET_FREQ 10
+
+// Length of the 3 2 1 countdown, in runs of the button task
+#define MATCH_COUNTDOWN_TICKS (3 * MATCH_BUTTON_FREQ)
+
+// The host board pushes the nav switch to pair this often until the other board responds, in runs of the button task
+#define MATCH_PAIRING_RETRY_TICKS (MATCH_BUTTON_FREQ / 2)
+
+// Chance of the player making an input on each run of the button task, out of 256
+#define MATCH_INPUT_CHANCE 12
+
+// Time the boards keep running after both reach game over, so any late retransmissions are delivered
+#define MATCH_DRAIN_US 5000000
+
+// A match that hasn't finished after this long is stuck
+#define MATCH_TIMEOUT_US (3600 * 1000000ULL)
+
+#define US_PER_SECOND 1000000
+
+typedef struct {
+    uint32_t num_matches;
+    uint64_t seed;
+    uint8_t start_level;
+
+    /** extra Die packets each board sends when it dies, to fill the table of packets waiting to be acknowledged */
+    uint8_t die_copies;
+    bool ai;
+    bool verbose;
+    loopback_config_t link;
+} match_config_t;
+
+typedef struct match_board match_board_t;
+
+/** A periodic task of a simulated board */
+typedef struct {
+    void (*func)(match_board_t* board);
+    uint64_t period;
+    uint64_t next;
+} match_task_t;
+
+#define MATCH_NUM_TASKS 4
+
+/** One of the two boards in a match */
+struct match_board {
+    uint8_t id;
+    game_data_t data;
+    packet_link_t link;
+    match_task_t tasks[MATCH_NUM_TASKS];
+
+    /** runs of the button task since the board entered its current state */
+    uint32_t state_ticks;
+    game_state_t last_state;
+
+    uint64_t rng;
+
+    /** the level the engine is started at when the round starts */
+    uint8_t start_level;
+
+    /** extra Die packets still to be queued, see `die_copies` */
+    uint8_t die_copies;
+    uint8_t die_copies_left;
+
+    /** the computer player, used instead of random inputs when `ai` is set */
+    bool use_ai;
+    ai_t ai;
+
+    /** number of times the board paused, and the total time spent paused */
+    uint32_t pauses;
+    uint64_t paused_us;
+    uint64_t paused_since;
+};
+
+/** Totals over every match */
+typedef struct {
+    uint64_t matches;
+    uint64_t stuck;
+    uint64_t mismatches;
+    uint64_t sim_us;
+    uint64_t pauses;
+    uint64_t paused_us;
+    uint64_t lines;
+    uint64_t bytes_sent;
+    uint64_t bytes_lost;
+    uint64_t bytes_corrupted;
+    uint64_t received;
+    uint64_t dropped;
+    uint64_t invalid;
+    uint64_t overflows;
+    uint64_t retransmits;
+    uint64_t deferred;
+    uint64_t pings_missed;
+
+    /** round trip stats of the boards that measured it (the hosts), in link ticks */
+    uint64_t rtt_boards;
+    uint64_t srtt;
+    uint64_t rttvar;
+    uint64_t heartbeat;
+    uint8_t rtt_min;
+    uint8_t rtt_max;
+} match_stats_t;
+
+/** The current time of the match being played, in microseconds */
+static uint64_t now;
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Make `board` the board that `game_data` and the packet functions act on.
+ */
+static void match_board_select(match_board_t* board)
+{
+    game_data = &board->data;
+    packet_link = &board->link;
+}
+
+/**
+ * @brief Queue the extra Die packets that haven't been queued yet, as many as there are free pending slots for.
+ */
+static void board_queue_die_copies(match_board_t* board)
+{
+    packet_t die_packet = {
+        .id = DIE_PACKET,
+        .data = game_data->engine.lines_cleared,
+    };
+    while (board->die_copies_left && packet_queue(die_packet))
+        board->die_copies_left--;
+}
+
+/**
+ * @brief Same as `game_update` in game.c, also starts sending the extra Die packets when the board dies.
+ */
+static void board_update(match_board_t* board)
+{
+    engine_event_t event = engine_update(&game_data->engine);
+    handle_engine_event(event);
+    if (event.died)
+        board->die_copies_left = board->die_copies;
+}
+
+/**
+ * @brief Same as `button_task` in game.c, with a random player instead of the nav switch.
+ */
+static void board_button_task(match_board_t* board)
+{
+    if (game_data->game_state != board->last_state)
+    {
+        board->last_state = game_data->game_state;
+        board->state_ticks = 0;
+    }
+    board->state_ticks++;
+
+    switch (game_data->game_state)
+    {
+    case GAME_STATE_MAIN_MENU:
+        {
+            // only the first board pairs, it keeps pushing the nav switch until the other board responds
+            if (board->id == 0 && board->state_ticks % MATCH_PAIRING_RETRY_TICKS == 1)
+                send_pairing_packet();
+            break;
+        }
+
+    case GAME_STATE_STARTING:
+        {
+            // the countdown is shown by the display task in game.c
+            if (board->state_ticks >= MATCH_COUNTDOWN_TICKS)
+            {
+                game_data_start_round();
+                engine_set_start_level(&game_data->engine, board->start_level);
+                game_data->game_state = GAME_STATE_PLAYING;
+                if (board->use_ai)
+                    ai_init(&board->ai, NULL, 0, 0);
+            }
+            break;
+        }
+
+    case GAME_STATE_PLAYING:
+        {
+            uint64_t r = xorshift64(&board->rng);
+            if (board->use_ai)
+                engine_input(&game_data->engine, ai_next_input(&board->ai, &game_data->engine));
+            else if ((r & 0xFF) < MATCH_INPUT_CHANCE)
+                engine_input(&game_data->engine, ENGINE_INPUT_LEFT + (r >> 8) % (ENGINE_INPUT_ROTATE - ENGINE_INPUT_LEFT + 1));
+
+            board_update(board);
+            break;
+        }
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Same as `ir_update_task` in game.c.
+ */
+static void board_ir_update_task(__attribute__((unused)) match_board_t* board)
+{
+    packet_process();
+}
+
+/**
+ * @brief Same as `ir_tx_task` in game.c.
+ */
+static void board_ir_tx_task(__attribute__((unused)) match_board_t* board)
+{
+    packet_transmit();
+}
+
+/**
+ * @brief Same as `send_packet_task` in game.c, also records how long the board is paused for.
+ */
+static void board_send_packet_task(match_board_t* board)
+{
+    bool was_paused = game_data->game_state == GAME_STATE_PAUSED;
+    check_packets();
+    board_queue_die_copies(board);
+    bool paused = game_data->game_state == GAME_STATE_PAUSED;
+
+    if (!was_paused && paused)
+    {
+        board->pauses++;
+        board->paused_since = now;
+    }
+    else if (was_paused && !paused)
+        board->paused_us += now - board->paused_since;
+}
+
+/**
+ * @brief Set up a board at the main menu, as `game_reset` does when the UCFK4 starts.
+ */
+static void match_board_init(match_board_t* board, uint8_t id, loopback_t* loopback, const match_config_t* config, uint64_t seed)
+{
+    board->id = id;
+    board->rng = seed | 1;
+    board->start_level = config->start_level;
+    board->die_copies = config->die_copies;
+    board->die_copies_left = 0;
+    board->use_ai = config->ai;
+    board->state_ticks = 0;
+    board->last_state = GAME_STATE_MAIN_MENU;
+    board->pauses = 0;
+    board->paused_us = 0;
+
+    packet_init(&board->link, loopback_transport(loopback, id));
+    game_data = &board->data;
+    srand(seed);
+    game_data_reset();
+
+    match_task_t tasks[MATCH_NUM_TASKS] = {
+        {.func = board_button_task,      .period = US_PER_SECOND / MATCH_BUTTON_FREQ     },
+        {.func = board_ir_update_task,   .period = US_PER_SECOND / MATCH_IR_FREQ         },
+        {.func = board_ir_tx_task,       .period = US_PER_SECOND / MATCH_IR_TX_FREQ      },
+        {.func = board_send_packet_task, .period = US_PER_SECOND / MATCH_SEND_PACKET_FREQ},
+    };
+
+    // the boards aren't started at exactly the same time
+    for (uint8_t i = 0; i < MATCH_NUM_TASKS; i++)
+    {
+        board->tasks[i] = tasks[i];
+        board->tasks[i].next = xorshift64(&board->rng) % tasks[i].period;
+    }
+}
+
+/**
+ * @brief Whether each board has handled every reliable packet the other board sent, and neither has any left to send.
+ */
+static bool match_delivered(const match_board_t* boards)
+{
+    for (uint8_t id = 0; id < 2; id++)
+    {
+        if (boards[id].die_copies_left || boards[id].link.tx_seq != boards[!id].link.rx_seq)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Play one match between two boards.
+ * @return false if the match got stuck, or the boards disagree on the number of lines cleared.
+ */
+static bool play_match(const match_config_t* config, uint32_t index, match_stats_t* stats)
+{
+    static loopback_t loopback;
+    static match_board_t boards[2];
+
+    loopback_config_t link = config->link;
+    link.seed = config->seed * 0x9E3779B97F4A7C15ULL + index;
+    loopback_init(&loopback, &link);
+
+    for (uint8_t id = 0; id < 2; id++)
+        match_board_init(&boards[id], id, &loopback, config, link.seed * 2 + id);
+
+    now = 0;
+    uint64_t game_over_at = 0;
+    while (now < MATCH_TIMEOUT_US)
+    {
+        // run whichever task is due next
+        match_board_t* board = NULL;
+        match_task_t* task = NULL;
+        for (uint8_t id = 0; id < 2; id++)
+        {
+            for (uint8_t i = 0; i < MATCH_NUM_TASKS; i++)
+            {
+                if (!task || boards[id].tasks[i].next < task->next)
+                {
+                    board = &boards[id];
+                    task = &boards[id].tasks[i];
+                }
+            }
+        }
+
+        now = task->next;
+        task->next += task->period;
+        loopback_set_time(&loopback, now);
+        match_board_select(board);
+        task->func(board);
+
+        bool game_over = boards[0].data.game_state == GAME_STATE_GAME_OVER && boards[1].data.game_state == GAME_STATE_GAME_OVER;
+        if (game_over && !game_over_at)
+            game_over_at = now;
+        if (game_over_at && now - game_over_at >= MATCH_DRAIN_US && match_delivered(boards))
+            break;
+    }
+
+    bool stuck = !game_over_at || !match_delivered(boards);
+    bool mismatch = boards[0].data.their_lines_cleared != boards[1].data.engine.lines_cleared
+                    || boards[1].data.their_lines_cleared != boards[0].data.engine.lines_cleared
+                    || boards[0].data.engine.seed != boards[1].data.engine.seed;
+
+    stats->matches++;
+    stats->stuck += stuck;
+    stats->mismatches += !stuck && mismatch;
+    stats->sim_us += game_over_at ? game_over_at : now;
+
+    for (uint8_t id = 0; id < 2; id++)
+    {
+        match_board_t* board = &boards[id];
+        const packet_stats_t* link_stats = &board->link.stats;
+        const loopback_channel_t* channel = &loopback.channels[id];
+
+        stats->pauses += board->pauses;
+        stats->paused_us += board->paused_us;
+        stats->lines += board->data.engine.lines_cleared;
+        stats->bytes_sent += channel->sent;
+        stats->bytes_lost += channel->lost;
+        stats->bytes_corrupted += channel->corrupted;
+        stats->received += link_stats->received;
+        stats->dropped += link_stats->dropped;
+        stats->invalid += link_stats->invalid;
+        stats->overflows += link_stats->overflows;
+        stats->retransmits += link_stats->retransmits;
+        stats->deferred += link_stats->deferred;
+        stats->pings_missed += link_stats->pings_missed;
+
+        if (link_stats->rtt_max)
+        {
+            if (!stats->rtt_boards || link_stats->rtt_min < stats->rtt_min)
+                stats->rtt_min = link_stats->rtt_min;
+            if (link_stats->rtt_max > stats->rtt_max)
+                stats->rtt_max = link_stats->rtt_max;
+            stats->rtt_boards++;
+            stats->srtt += link_stats->srtt;
+            stats->rttvar += link_stats->rttvar;
+            stats->heartbeat += link_stats->heartbeat;
+        }
+    }
+
+    if (config->verbose && (stuck || mismatch))
+    {
+        printf("match %u: %s, states %d %d, reliable %u/%u and %u/%u, lines %u/%u and %u/%u\n", index,
+               stuck ? "stuck" : "lines or seed mismatch", boards[0].data.game_state, boards[1].data.game_state,
+               boards[1].link.rx_seq, boards[0].link.tx_seq, boards[0].link.rx_seq, boards[1].link.tx_seq,
+               boards[0].data.engine.lines_cleared, boards[1].data.their_lines_cleared,
+               boards[1].data.engine.lines_cleared, boards[0].data.their_lines_cleared);
+    }
+
+    return !stuck && !mismatch;
+}
+
+int main(int argc, char** argv)
+{
+    match_config_t config = {
+        .num_matches = MATCH_DEFAULT_MATCHES,
+        .seed = MATCH_DEFAULT_SEED,
+        .start_level = MATCH_DEFAULT_LEVEL,
+        .die_copies = 0,
+        .ai = false,
+        .verbose = false,
+        .link = {
+            .byte_us = US_PER_SECOND * 10 / MATCH_DEFAULT_BAUD,
+            .latency_us = 0,
+            .loss = 0,
+            .corruption = 0,
+        },
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:s:b:l:x:c:L:D:av")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            config.num_matches = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'b':
+            config.link.byte_us = US_PER_SECOND * 10 / strtoul(optarg, NULL, 0);
+            break;
+
+        case 'l':
+            config.link.latency_us = strtod(optarg, NULL) * 1000;
+            break;
+
+        case 'x':
+            config.link.loss = strtod(optarg, NULL);
+            break;
+
+        case 'c':
+            config.link.corruption = strtod(optarg, NULL);
+            break;
+
+        case 'L':
+            config.start_level = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'D':
+            config.die_copies = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'a':
+            config.ai = true;
+            break;
+
+        case 'v':
+            config.verbose = true;
+            break;
+
+        default:
+            fprintf(stderr, "Usage: %s [-m matches] [-s seed] [-b baud] [-l latency_ms] [-x loss] [-c corruption] [-L level] [-D copies] [-a] [-v]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (config.num_matches == 0 || config.link.byte_us == 0)
+    {
+        fprintf(stderr, "matches and baud must be greater than 0\n");
+        return EXIT_FAILURE;
+    }
+
+    match_stats_t stats = {0};
+    uint32_t failures = 0;
+    double start = time_now();
+    for (uint32_t i = 0; i < config.num_matches; i++)
+        failures += !play_match(&config, i, &stats);
+    double elapsed = time_now() - start;
+
+    double matches = stats.matches;
+    printf("matches:       %llu\n", (unsigned long long)stats.matches);
+    printf("stuck:         %llu\n", (unsigned long long)stats.stuck);
+    printf("mismatches:    %llu\n", (unsigned long long)stats.mismatches);
+    printf("elapsed:       %.3f s\n", elapsed);
+    printf("matches/s:     %.0f\n", matches / elapsed);
+    printf("sim s/match:   %.1f\n", stats.sim_us / matches / US_PER_SECOND);
+    printf("lines/match:   %.2f\n", stats.lines / matches);
+    printf("pauses/match:  %.2f\n", stats.pauses / matches);
+    printf("paused:        %.2f%%\n", 100.0 * stats.paused_us / (2 * stats.sim_us));
+    printf("bytes/match:   %.1f (%.2f%% lost, %.2f%% corrupted)\n", stats.bytes_sent / matches,
+           100.0 * stats.bytes_lost / stats.bytes_sent, 100.0 * stats.bytes_corrupted / stats.bytes_sent);
+    printf("packets:       %llu received, %llu retransmitted, %llu deferred, %llu frames dropped, %llu invalid, %llu overflowed bytes\n",
+           (unsigned long long)stats.received, (unsigned long long)stats.retransmits, (unsigned long long)stats.deferred,
+           (unsigned long long)stats.dropped, (unsigned long long)stats.invalid, (unsigned long long)stats.overflows);
+
+    // link ticks to ms
+    double tick_ms = 1000.0 / PACKET_TICK_FREQ;
+    double rtt_boards = stats.rtt_boards ? stats.rtt_boards : 1;
+    printf("rtt:           %.1f ms smoothed (%.1f ms deviation), %.0f to %.0f ms\n", stats.srtt * tick_ms / rtt_boards,
+           stats.rttvar * tick_ms / rtt_boards, stats.rtt_min * tick_ms, stats.rtt_max * tick_ms);
+    printf("heartbeat:     %.0f ms at the end of a match, %.2f pings missed/match\n", stats.heartbeat * tick_ms / rtt_boards,
+           stats.pings_missed / matches);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -6,62 +6,526 @@
 
 #include "packet.h"
 
-#include <ir_uart.h>
+#include <string.h>
 
 #include "game_data.h"
 
+// Length of the payload of each packet id, in bytes
+static const uint8_t packet_data_len[_PACKET_COUNT] = {
+    [PAIRING_PACKET] = 4,
+    [PING_PACKET] = 4,
+    [PONG_PACKET] = 3,
+    [LINE_CLEAR_PACKET] = 2,
+    [DIE_PACKET] = 2,
+    [ACK_PACKET] = 1,
+};
+
+// Reliable packets are sent with a sequence number, and retransmitted until the other board sends an ACK_PACKET for it
+static const bool packet_reliable[_PACKET_COUNT] = {
+    [PAIRING_ACK_PACKET] = true,
+    [DIE_PACKET] = true,
+};
+
+// Length of a packet in a frame: its id, sequence number if it's reliable, and payload
+#define PACKET_RECORD_LEN(id) (1 + packet_reliable[id] + packet_data_len[id])
+
+/**
+ * The link packets are currently sent and received on.
+ */
+packet_link_t* packet_link = NULL;
+
+/**
+ * @brief Update a CRC-16/CCITT (polynomial 0x1021) with the next byte.
+ */
+static uint16_t crc16_update(uint16_t crc, uint8_t byte)
+{
+    crc ^= (uint16_t)byte << 8;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+
+    return crc;
+}
+
+/**
+ * @brief Checksum of a frame, over its length and packet bytes.
+ */
+static uint16_t frame_checksum(const uint8_t* body, uint8_t len)
+{
+    uint16_t crc = crc16_update(0xFFFF, len);
+    for (uint8_t i = 0; i < len; i++)
+        crc = crc16_update(crc, body[i]);
+
+    return crc;
+}
+
+/**
+ * @brief Feed the next byte received from the transport into the frame being received.
+ */
+static void frame_receive(uint8_t byte)
+{
+    packet_rx_frame_t* frame = &packet_link->rx_frame;
+
+    switch (frame->state)
+    {
+    case FRAME_SYNC:
+        if (byte == PACKET_FRAME_SYNC)
+            frame->state = FRAME_LEN;
+        break;
+
+    case FRAME_LEN:
+        // a length that can't be valid means we didn't really see the start of a frame
+        if (byte == 0 || byte > PACKET_FRAME_MAX_LEN)
+        {
+            packet_link->stats.dropped++;
+            frame->state = byte == PACKET_FRAME_SYNC ? FRAME_LEN : FRAME_SYNC;
+            break;
+        }
+
+        frame->len = byte;
+        frame->pos = 0;
+        frame->state = FRAME_BODY;
+        break;
+
+    case FRAME_BODY:
+        frame->body[frame->pos++] = byte;
+        if (frame->pos == frame->len)
+            frame->state = FRAME_CHECKSUM;
+        break;
+
+    case FRAME_CHECKSUM:
+        frame->checksum = byte;
+        frame->state = FRAME_CHECKSUM_HIGH;
+        break;
+
+    case FRAME_CHECKSUM_HIGH:
+        // drop the frame if it was corrupted
+        frame->checksum |= (uint16_t)byte << 8;
+        if (frame->checksum != frame_checksum(frame->body, frame->len))
+        {
+            packet_link->stats.dropped++;
+            frame->state = FRAME_SYNC;
+            break;
+        }
+
+        frame->pos = 0;
+        frame->state = FRAME_READY;
+        break;
+
+    default:
+        break;
+    }
+}
+
 /**
- * @brief Decode the given `byte` into the `packet`.
- * @param byte The unmodified uint8_t received from the IR sensor.
- * @param packet Pass by reference `packet` object.
- * @return Whether the byte that was decoded is valid.
- *         i.e. the packet ID received is valid.
+ * @brief Decode the next packet of the received frame into `packet`.
+ * @return Whether a valid packet was decoded. i.e. the packet ID received is valid and its payload is in the frame.
  */
-bool packet_decode(uint8_t byte, packet_t* packet)
+static bool packet_decode(packet_t* packet)
 {
-    packet->raw = byte;
+    packet_rx_frame_t* frame = &packet_link->rx_frame;
+    if (frame->pos >= frame->len)
+        return false;
+
+    uint8_t id = frame->body[frame->pos];
 
     // ignore invalid ID recvd
-    if (packet->id < 0 || packet->id >= _PACKET_COUNT)
+    if (id >= _PACKET_COUNT || frame->pos + PACKET_RECORD_LEN(id) > frame->len)
+    {
+        packet_link->stats.invalid++;
         return false;
+    }
 
+    frame->pos++;
+    packet->id = id;
+    packet->seq = packet_reliable[id] ? frame->body[frame->pos++] : 0;
+    packet->data = 0;
+    for (uint8_t i = 0; i < packet_data_len[id]; i++)
+        packet->data |= (uint32_t)frame->body[frame->pos++] << (8 * i);
+
+    packet_link->stats.received++;
     return true;
 }
 
 /**
- * @brief Encode the given packet into a uint8_t byte to be sent by IR.
- * @param packet The packet to be sent
- * @return The byte to be sent by the IR transmitter.
+ * @brief Handle the sequence number of a received packet. Reliable packets are acknowledged, and handled
+ *        in the order they were sent. An ACK_PACKET stops retransmitting the packet it acknowledges.
+ * @return false if the packet was only used by the transport, is out of order, or has already been handled.
  */
-uint8_t packet_encode(packet_t packet)
+static bool packet_receive(const packet_t* packet)
 {
-    return packet.raw;
+    // any packet shows the other board is still there
+    packet_link->heartbeat.heard = packet_link->tick;
+
+    if (packet->id == ACK_PACKET)
+    {
+        for (uint8_t i = 0; i < PACKET_MAX_PENDING; i++)
+        {
+            if (packet_link->pending[i].active && packet_link->pending[i].packet.seq == packet->data)
+                packet_link->pending[i].active = false;
+        }
+
+        return false;
+    }
+
+    if (!packet_reliable[packet->id])
+        return true;
+
+    // an earlier reliable packet was lost, don't acknowledge this one so it is retransmitted after it
+    int8_t ahead = packet->seq - packet_link->rx_seq;
+    if (ahead > 0)
+        return false;
+
+    // always acknowledge, in case our previous ack was lost
+    packet_t ack = {
+        .id = ACK_PACKET,
+        .data = packet->seq,
+    };
+    packet_queue(ack);
+
+    // a retransmission of a packet we have already handled
+    if (ahead < 0)
+        return false;
+
+    packet_link->rx_seq++;
+    return true;
+}
+
+/**
+ * @brief Read the bytes waiting in the transport into the receive buffer, at most `PACKET_RX_BUDGET` per call.
+ */
+void packet_poll(void)
+{
+    const transport_t* transport = packet_link->transport;
+    packet_rx_ring_t* ring = &packet_link->rx_ring;
+
+    uint8_t head = ring->head;
+    for (uint8_t i = 0; i < PACKET_RX_BUDGET && transport->read_ready(transport->ctx); i++)
+    {
+        uint8_t byte = transport->read(transport->ctx);
+
+        // the receive buffer is full, the byte is lost
+        if ((uint8_t)(head - ring->tail) == PACKET_RX_BUFFER_SIZE)
+        {
+            packet_link->stats.overflows++;
+            continue;
+        }
+
+        ring->buffer[head++ % PACKET_RX_BUFFER_SIZE] = byte;
+    }
+
+    ring->head = head;
 }
 
 /**
- * @brief Read the next byte from the IR receiver and decode into the given `packet`.
- * @param packet Pass by reference `packet` object for the byte to be decoded into.
- * @return true if a *valid* packet was received from IR and decoded into `packet`.
- * @return false if there wasn't a byte ready to be received, or if an invalid packet was read.
+ * @brief Decode the next packet of a frame received by `packet_poll` into `packet`.
+ * @param packet Pass by reference `packet` object for the packet to be decoded into.
+ * @return true if a *valid* packet was received and decoded into `packet`.
+ * @return false if there are no more packets ready to be handled.
  */
 bool packet_get(packet_t* packet)
 {
-    // wait until a byte is ready to be read
-    if (!ir_uart_read_ready_p())
-        return false;
+    while (true)
+    {
+        if (packet_link->rx_frame.state == FRAME_READY)
+        {
+            if (packet_decode(packet))
+            {
+                if (packet_receive(packet))
+                    return true;
+
+                continue;
+            }
 
-    uint8_t byte = ir_uart_getc();
-    return packet_decode(byte, packet);
+            // handled every packet in the frame (or the rest of it is invalid), wait for the next frame
+            packet_link->rx_frame.state = FRAME_SYNC;
+        }
+
+        // wait until a byte is ready to be read
+        packet_rx_ring_t* ring = &packet_link->rx_ring;
+        uint8_t tail = ring->tail;
+        if (tail == ring->head)
+            return false;
+
+        frame_receive(ring->buffer[tail++ % PACKET_RX_BUFFER_SIZE]);
+        ring->tail = tail;
+    }
 }
 
 /**
- * @brief Encode the given `packet` into a byte and transmit it via IR.
- * @param packet The packet to be encoded and sent
+ * @brief Encode `packet` into `record`.
+ * @return The length of the record.
  */
-void packet_send(packet_t packet)
+static uint8_t packet_encode(const packet_t* packet, uint8_t* record)
 {
-    uint8_t byte = packet_encode(packet);
-    ir_uart_putc(byte);
+    uint8_t len = 0;
+    record[len++] = packet->id;
+    if (packet_reliable[packet->id])
+        record[len++] = packet->seq;
+
+    for (uint8_t i = 0; i < packet_data_len[packet->id]; i++)
+        record[len++] = packet->data >> (8 * i);
+
+    return len;
+}
+
+/**
+ * @brief Check whether an identical packet is already queued in the next frame.
+ */
+static bool packet_is_queued(const uint8_t* record, uint8_t len)
+{
+    const packet_tx_frame_t* frame = &packet_link->tx_frame;
+    for (uint8_t pos = 0; pos < frame->len; pos += PACKET_RECORD_LEN(frame->body[pos]))
+    {
+        // the id sets the length of a record, so the rest is only compared once the ids match
+        if (frame->body[pos] == record[0] && memcmp(&frame->body[pos + 1], &record[1], len - 1) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Add an encoded packet to the next frame, unless an identical packet is already queued.
+ */
+static void packet_queue_record(const packet_t* packet)
+{
+    packet_tx_frame_t* frame = &packet_link->tx_frame;
+
+    uint8_t record[PACKET_RECORD_MAX_LEN];
+    uint8_t len = packet_encode(packet, record);
+    if (packet_is_queued(record, len))
+        return;
+
+    // no room left in this frame, send it now
+    if (frame->len + len > PACKET_FRAME_MAX_LEN)
+        packet_flush();
+
+    memcpy(&frame->body[frame->len], record, len);
+    frame->len += len;
+}
+
+/**
+ * @brief Queue the given `packet` to be sent in the next frame.
+ *        Reliable packets are given a sequence number, and retransmitted by `packet_update` until they are acknowledged.
+ *        Identical unreliable packets are only queued once per frame.
+ * @param packet The packet to be sent
+ * @return false if the packet is reliable and `PACKET_MAX_PENDING` packets are already waiting to be acknowledged.
+ *         It isn't sent, and must be queued again later.
+ */
+bool packet_queue(packet_t packet)
+{
+    if (packet_reliable[packet.id])
+    {
+        // remember the packet until it is acknowledged
+        packet_pending_t* pending = NULL;
+        for (uint8_t i = 0; i < PACKET_MAX_PENDING && !pending; i++)
+        {
+            if (!packet_link->pending[i].active)
+                pending = &packet_link->pending[i];
+        }
+
+        // The receiver handles reliable packets in order, so one with a sequence number that is never retransmitted
+        // would block every later one if it was lost. Don't give it a sequence number until it can be retransmitted.
+        if (!pending)
+        {
+            packet_link->stats.deferred++;
+            return false;
+        }
+
+        packet.seq = packet_link->tx_seq++;
+        pending->packet = packet;
+        pending->sent = packet_link->tick;
+        pending->backoff = 0;
+        pending->active = true;
+    }
+
+    packet_queue_record(&packet);
+    return true;
+}
+
+/**
+ * @brief Move the queued packets into the transmit buffer as one frame, if any are queued.
+ *        The frame is dropped if the transmit buffer is full, reliable packets will be retransmitted.
+ */
+void packet_flush(void)
+{
+    packet_tx_frame_t* frame = &packet_link->tx_frame;
+    packet_tx_ring_t* ring = &packet_link->tx_ring;
+    if (frame->len == 0)
+        return;
+
+    uint8_t free = PACKET_TX_BUFFER_SIZE - (uint8_t)(ring->head - ring->tail);
+    if (free >= frame->len + PACKET_FRAME_OVERHEAD)
+    {
+        uint8_t head = ring->head;
+        ring->buffer[head++ % PACKET_TX_BUFFER_SIZE] = PACKET_FRAME_SYNC;
+        ring->buffer[head++ % PACKET_TX_BUFFER_SIZE] = frame->len;
+        for (uint8_t i = 0; i < frame->len; i++)
+            ring->buffer[head++ % PACKET_TX_BUFFER_SIZE] = frame->body[i];
+
+        uint16_t checksum = frame_checksum(frame->body, frame->len);
+        ring->buffer[head++ % PACKET_TX_BUFFER_SIZE] = checksum;
+        ring->buffer[head++ % PACKET_TX_BUFFER_SIZE] = checksum >> 8;
+
+        // publish the frame once it has been completely written
+        ring->head = head;
+    }
+
+    frame->len = 0;
+}
+
+/**
+ * @brief Advance the link's clock by one tick, and queue a retransmission of every reliable packet
+ *        that hasn't been acknowledged within `PACKET_RETRANSMIT_TICKS`. Must be called at `PACKET_TICK_FREQ`.
+ */
+void packet_update(void)
+{
+    uint16_t now = ++packet_link->tick;
+    for (uint8_t i = 0; i < PACKET_MAX_PENDING; i++)
+    {
+        packet_pending_t* pending = &packet_link->pending[i];
+        if (!pending->active)
+            continue;
+
+        // back off exponentially, so retransmissions don't take over a bad link
+        if ((uint16_t)(now - pending->sent) >= (PACKET_RETRANSMIT_TICKS << pending->backoff))
+        {
+            pending->sent = now;
+            if (pending->backoff < PACKET_MAX_BACKOFF)
+                pending->backoff++;
+
+            packet_queue_record(&pending->packet);
+            packet_link->stats.retransmits++;
+        }
+    }
+}
+
+/**
+ * @brief Write as many bytes from the transmit buffer to the transport as it can take without waiting.
+ */
+void packet_transmit(void)
+{
+    const transport_t* transport = packet_link->transport;
+    packet_tx_ring_t* ring = &packet_link->tx_ring;
+
+    uint8_t tail = ring->tail;
+    while (tail != ring->head && transport->write_ready(transport->ctx))
+        transport->write(transport->ctx, ring->buffer[tail++ % PACKET_TX_BUFFER_SIZE]);
+
+    ring->tail = tail;
+}
+
+/**
+ * @brief Initialise `link` to send and receive packets on `transport`, and make it the current `packet_link`.
+ */
+void packet_init(packet_link_t* link, const transport_t* transport)
+{
+    memset(link, 0, sizeof(packet_link_t));
+    link->transport = transport;
+    link->stats.heartbeat = PACKET_HEARTBEAT_INITIAL_TICKS;
+    link->stats.timeout = PACKET_HEARTBEAT_MISSES * PACKET_HEARTBEAT_INITIAL_TICKS + PACKET_RETRANSMIT_TICKS;
+    packet_link = link;
+}
+
+/**
+ * @brief Returns the counts of the packets sent and received on the current link, and its round trip time.
+ */
+const packet_stats_t* packet_stats(void)
+{
+    return &packet_link->stats;
+}
+
+/**
+ * @brief Whether a packet has been received from the other board within the link timeout,
+ *        which is `PACKET_HEARTBEAT_MISSES` heartbeats plus the round trip timeout.
+ */
+bool packet_link_alive(void)
+{
+    return (uint16_t)(packet_link->tick - packet_link->heartbeat.heard) < packet_link->stats.timeout;
+}
+
+/**
+ * @brief Returns the round trip timeout: the smoothed round trip time plus 4 times its deviation (in link ticks).
+ */
+static uint16_t heartbeat_rto(void)
+{
+    const packet_heartbeat_t* heartbeat = &packet_link->heartbeat;
+    if (!heartbeat->rtt_valid)
+        return PACKET_RETRANSMIT_TICKS;
+
+    uint16_t rto = (heartbeat->srtt >> 3) + heartbeat->rttvar;
+    return rto < PACKET_RTO_MIN_TICKS ? PACKET_RTO_MIN_TICKS : rto;
+}
+
+/**
+ * @brief Update the round trip time estimate with a new measurement (in link ticks).
+ */
+static void heartbeat_sample(uint8_t rtt)
+{
+    packet_heartbeat_t* heartbeat = &packet_link->heartbeat;
+    packet_stats_t* stats = &packet_link->stats;
+
+    if (!heartbeat->rtt_valid)
+    {
+        heartbeat->srtt = rtt << 3;
+        heartbeat->rttvar = rtt << 1;
+        heartbeat->rtt_valid = true;
+        stats->rtt_min = rtt;
+        stats->rtt_max = rtt;
+    }
+    else
+    {
+        // srtt += err / 8, rttvar += (|err| - rttvar) / 4, using the scaled values
+        int16_t err = rtt - (heartbeat->srtt >> 3);
+        heartbeat->srtt += err;
+        if (err < 0)
+            err = -err;
+        heartbeat->rttvar += err - (heartbeat->rttvar >> 2);
+    }
+
+    stats->rtt = rtt;
+    stats->srtt = heartbeat->srtt >> 3;
+    stats->rttvar = heartbeat->rttvar >> 2;
+    if (rtt < stats->rtt_min)
+        stats->rtt_min = rtt;
+    if (rtt > stats->rtt_max)
+        stats->rtt_max = rtt;
+}
+
+/**
+ * @brief Forget every packet waiting to be sent or acknowledged, and which packets have been received.
+ *        Used when pairing, so nothing from the previous round is sent or handled in the new one.
+ */
+void packet_reset(void)
+{
+    packet_link->tx_frame.len = 0;
+    packet_link->tx_ring.tail = packet_link->tx_ring.head;
+    for (uint8_t i = 0; i < PACKET_MAX_PENDING; i++)
+        packet_link->pending[i].active = false;
+
+    // both boards reset when pairing, so each starts counting from 0 again
+    packet_link->tx_seq = 0;
+    packet_link->rx_seq = 0;
+
+    // keep the round trip estimate, the link is likely the same as last round. Ping straight away.
+    packet_heartbeat_t* heartbeat = &packet_link->heartbeat;
+    heartbeat->heard = packet_link->tick;
+    heartbeat->ping_outstanding = false;
+    heartbeat->ping_sent = packet_link->tick - packet_link->stats.heartbeat;
+}
+
+/**
+ * @brief Update the number of lines the other player has cleared, from the total in one of their packets.
+ *        Packets can arrive out of order, so the count only ever increases.
+ */
+static void update_their_lines_cleared(uint16_t total)
+{
+    // a late packet from a previous round
+    if (game_data->game_state == GAME_STATE_MAIN_MENU)
+        return;
+
+    if (total > game_data->their_lines_cleared)
+        game_data->their_lines_cleared = total;
 }
 
 /**
@@ -80,12 +544,13 @@ void handle_packet(packet_t packet)
 
             // recvd pairing packet, set the rng_seed and respond
             game_data->rng_seed = packet.data;
+            packet_reset();
 
             packet_t ack = {
                 .id = PAIRING_ACK_PACKET,
                 .data = 0,
             };
-            packet_send(ack);
+            packet_queue(ack);
             game_data->host = false;
             game_data->game_state = GAME_STATE_STARTING;
             break;
@@ -105,49 +570,50 @@ void handle_packet(packet_t packet)
 
     case PING_PACKET:
         {
-            game_data->recvd_pingpong = true;
+            update_their_lines_cleared(packet.data);
+
+            // use the host's timeout, it is the one measuring the round trip time
+            packet_link->stats.timeout = (uint16_t)(packet.data >> 24) << PACKET_TIMEOUT_SHIFT;
+
+            // echo the tick byte, so the host can measure the round trip time
             packet_t pong = {
                 .id = PONG_PACKET,
-                .data = 0,
+                .data = game_data->engine.lines_cleared | (packet.data & 0xFF0000),
             };
-            packet_send(pong);
+            packet_queue(pong);
             break;
         }
 
     case PONG_PACKET:
         {
-            game_data->recvd_pingpong = true;
+            update_their_lines_cleared(packet.data);
+
+            // only measure the answer to the latest PING, an older one would overestimate the round trip
+            packet_heartbeat_t* heartbeat = &packet_link->heartbeat;
+            uint8_t sent = packet.data >> 16;
+            if (heartbeat->ping_outstanding && sent == (uint8_t)heartbeat->ping_sent)
+            {
+                heartbeat->ping_outstanding = false;
+                heartbeat_sample((uint8_t)(packet_link->tick - heartbeat->ping_sent));
+            }
             break;
         }
 
     case LINE_CLEAR_PACKET:
         {
-            uint8_t num_cleared = packet.data;
-            game_data->their_lines_cleared += num_cleared;
+            update_their_lines_cleared(packet.data);
             break;
         }
 
     case DIE_PACKET:
         {
-            // Other player has died
-            game_data->other_player_dead = true;
-
-            // Acknowledge the packet
-            packet_t ack = {
-                .id = DIE_ACK_PACKET,
-                .data = 0,
-            };
-            packet_send(ack);
-            break;
-        }
-
-    case DIE_ACK_PACKET:
-        {
-            // For some reason the board thought we sent a die packet, when we aren't dead
-            if (game_data->game_state != GAME_STATE_DEAD)
+            // a late retransmission from a previous round
+            if (game_data->game_state == GAME_STATE_MAIN_MENU || game_data->game_state == GAME_STATE_GAME_OVER)
                 return;
 
-            game_data->die_packet_acknowledged = true;
+            // Other player has died
+            game_data->other_player_dead = true;
+            update_their_lines_cleared(packet.data);
             break;
         }
 
@@ -157,20 +623,24 @@ void handle_packet(packet_t packet)
 }
 
 /**
- * Checks to see if we should send the die packet.
- * This function checks if both players are dead, then the game is over.
+ * @brief Queue the Die packet once we have died, if it hasn't been queued yet.
+ *        It is reliable, so it waits here until a pending slot is free.
  */
 void check_die_packet(void)
 {
-    // We are dead but board has not acknlowdged our die packet
-    if (game_data->game_state == GAME_STATE_DEAD && !game_data->die_packet_acknowledged)
-    {
-        packet_t die = {
-            .id = DIE_PACKET,
-            .data = 0,
-        };
-        packet_send(die);
-    }
+    if (game_data->die_queued)
+        return;
+
+    // we stay dead until the game is over
+    if (game_data->game_state != GAME_STATE_DEAD && game_data->game_state != GAME_STATE_GAME_OVER)
+        return;
+
+    // reliable, so it is retransmitted until the other board acknowledges it
+    packet_t die_packet = {
+        .id = DIE_PACKET,
+        .data = game_data->engine.lines_cleared,
+    };
+    game_data->die_queued = packet_queue(die_packet);
 }
 
 /**
@@ -178,12 +648,124 @@ void check_die_packet(void)
  */
 void check_ping_pong_packet(void)
 {
-    if (game_data->host)
+    if (!game_data->host)
+        return;
+
+    packet_heartbeat_t* heartbeat = &packet_link->heartbeat;
+    packet_stats_t* stats = &packet_link->stats;
+    if ((uint16_t)(packet_link->tick - heartbeat->ping_sent) < stats->heartbeat)
+        return;
+
+    // ping less often while the link is good, and more often once a PING goes unanswered to notice a lost link quickly
+    uint16_t heartbeat_ticks = stats->heartbeat;
+    uint8_t missed = heartbeat->ping_outstanding ? UINT8_MAX : 0;
+    if (missed)
     {
-        packet_t ping = {
-            .id = PING_PACKET,
-            .data = 0,
+        stats->pings_missed++;
+        heartbeat_ticks /= 2;
+    }
+    else
+        heartbeat_ticks += PACKET_HEARTBEAT_STEP_TICKS;
+
+    // loss += (missed - loss) / 8
+    stats->ping_loss += ((int16_t)missed - stats->ping_loss) / 8;
+
+    // don't ping again before the PONG could have arrived
+    uint16_t rto = heartbeat_rto();
+    if (heartbeat_ticks < rto)
+        heartbeat_ticks = rto;
+    if (heartbeat_ticks < PACKET_HEARTBEAT_MIN_TICKS)
+        heartbeat_ticks = PACKET_HEARTBEAT_MIN_TICKS;
+    if (heartbeat_ticks > PACKET_HEARTBEAT_MAX_TICKS)
+        heartbeat_ticks = PACKET_HEARTBEAT_MAX_TICKS;
+    stats->heartbeat = heartbeat_ticks;
+
+    // allow more missed heartbeats the more PINGs are being lost, so a lossy link doesn't keep pausing.
+    // Round up to the units sent in the PING, so both boards use the same timeout.
+    uint8_t misses = PACKET_HEARTBEAT_MISSES + (stats->ping_loss >> PACKET_LOSS_MISSES_SHIFT);
+    uint16_t timeout = (misses * heartbeat_ticks + rto + (1 << PACKET_TIMEOUT_SHIFT) - 1) >> PACKET_TIMEOUT_SHIFT;
+    if (timeout > UINT8_MAX)
+        timeout = UINT8_MAX;
+    stats->timeout = timeout << PACKET_TIMEOUT_SHIFT;
+
+    heartbeat->ping_sent = packet_link->tick;
+    heartbeat->ping_outstanding = true;
+
+    packet_t ping = {
+        .id = PING_PACKET,
+        .data = game_data->engine.lines_cleared | (uint32_t)(uint8_t)packet_link->tick << 16 | (uint32_t)timeout << 24,
+    };
+    packet_queue(ping);
+}
+
+/**
+ * @brief Send the Pairing packet with our seed, and become the host. The link is reset first,
+ *        so nothing from the previous round is sent or handled in the new one.
+ *        The other board should respond with PairingAck, then the game will commence.
+ */
+void send_pairing_packet(void)
+{
+    packet_t pairing_packet = {
+        .id = PAIRING_PACKET,
+        .data = game_data->rng_seed,
+    };
+    packet_reset();
+    packet_queue(pairing_packet);
+    game_data->host = true;
+}
+
+/**
+ * @brief Tell the other board what happened in an update of our engine.
+ *        Queues a Line Clear packet if we cleared lines, and if we died, moves to the dead state and queues our Die packet.
+ */
+void handle_engine_event(engine_event_t event)
+{
+    // send Line Clear Packet to other board
+    if (event.lines_cleared)
+    {
+        packet_t line_clear_packet = {
+            .id = LINE_CLEAR_PACKET,
+            .data = game_data->engine.lines_cleared,
         };
-        packet_send(ping);
+        packet_queue(line_clear_packet);
     }
+
+    if (event.died)
+    {
+        game_data->game_state = GAME_STATE_DEAD;
+        check_die_packet();
+    }
+}
+
+/**
+ * @brief Drain the receiver and handle every packet that has arrived, then advance the link's clock
+ *        and send every packet queued since the last call as one frame. Must be called at `PACKET_TICK_FREQ`.
+ */
+void packet_process(void)
+{
+    packet_poll();
+
+    packet_t packet;
+    while (packet_get(&packet))
+        handle_packet(packet);
+
+    packet_update();
+    packet_flush();
+}
+
+/**
+ * @brief Check whether the game is over, send the Ping packet and pause if the other board stops responding,
+ *        and queue our Die packet if it couldn't be queued when we died. Called by the send packet task.
+ */
+void check_packets(void)
+{
+    // Check if the game is over
+    game_data_check_game_over();
+
+    // Ping / Pong functionality
+    check_ping_pong_packet();
+    game_data_check_pause();
+
+    // our Die packet, if it couldn't be queued when we died
+    check_die_packet();
 }
\ No newline at end of file
@@ -10,98 +10,333 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "engine.h"
+#include "transport.h"
+
+/**
+ * Packets are sent over a transport (the IR UART on the UCFK4) in frames, so every packet queued during the same tick shares one transmission.
+ * A frame is laid out as:
+ * - `PACKET_FRAME_SYNC`, marks the start of a frame
+ * - length, the number of bytes of packets in the frame (1 to `PACKET_FRAME_MAX_LEN`)
+ * - packets, each is its id byte, then a sequence number if the packet is reliable, followed by its payload.
+ *   The payload length depends on the id (see `PacketID`), multi-byte payloads are little endian.
+ * - checksum, CRC-16/CCITT of the length and packet bytes (little endian). Frames with a bad checksum are dropped.
+ */
+#define PACKET_FRAME_SYNC    0xA5
+#define PACKET_FRAME_MAX_LEN 16
+
+// sync + length + checksum
+#define PACKET_FRAME_OVERHEAD 4
+
+// id + sequence number + largest payload
+#define PACKET_RECORD_MAX_LEN 6
+
+// Size of the ring buffer of bytes received but not yet decoded, must be a power of 2 no larger than 256
+#define PACKET_RX_BUFFER_SIZE 32
+
+// Maximum number of bytes read from the transport per call to `packet_poll`, so it can't starve the other tasks
+#define PACKET_RX_BUDGET 16
+
+// Size of the ring buffer of frames waiting to be transmitted, must be a power of 2 no larger than 256
+#define PACKET_TX_BUFFER_SIZE 64
+
+// Maximum number of reliable packets waiting to be acknowledged
+#define PACKET_MAX_PENDING 8
+
+/** Rate of the link's clock (in Hz), one tick per call to `packet_update` */
+#define PACKET_TICK_FREQ 100
+
+// Time to wait for a reliable packet to be acknowledged before sending it again (in link ticks, 250ms)
+#define PACKET_RETRANSMIT_TICKS (PACKET_TICK_FREQ / 4)
+
+// The time between retransmissions doubles each time, up to `PACKET_RETRANSMIT_TICKS << PACKET_MAX_BACKOFF` (2s)
+#define PACKET_MAX_BACKOFF 3
+
 /**
- * The size of an IR packet is one byte, so together these should sum to 8 bits
- * Packet id is stored in the upper bits.
- * Packet data is stored in the lower bits.
+ * The host sends a PING every heartbeat, which adapts to the link: it grows by `PACKET_HEARTBEAT_STEP_TICKS` for every
+ * PING that is answered, and halves when one isn't, between the min and max below. It is never shorter than the
+ * estimated round trip time. All in link ticks.
  */
-#define PACKET_ID_LEN   3
-#define PACKET_DATA_LEN 5
+#define PACKET_HEARTBEAT_MIN_TICKS     (PACKET_TICK_FREQ / 4)   // 250ms
+#define PACKET_HEARTBEAT_MAX_TICKS     PACKET_TICK_FREQ         // 1s
+#define PACKET_HEARTBEAT_INITIAL_TICKS (PACKET_TICK_FREQ / 2)   // 500ms
+#define PACKET_HEARTBEAT_STEP_TICKS    (PACKET_TICK_FREQ / 10)  // 100ms
 
-// equivalent to `2^(PACKET_ID_LEN)`
-#define PACKET_ID_MAX_VAL (1 << PACKET_ID_LEN)
+// Number of heartbeats that can pass without hearing from the other board before the link is considered lost
+#define PACKET_HEARTBEAT_MISSES 2
 
-// equivalent to `2^(PACKET_DATA_LEN)`
-#define PACKET_DATA_MAX_VAL (1 << PACKET_DATA_LEN)
+// One more heartbeat is allowed for every `1 << PACKET_LOSS_MISSES_SHIFT` of `ping_loss` (out of 255), up to 3 more
+#define PACKET_LOSS_MISSES_SHIFT 6
+
+// Lower bound of the round trip timeout (in link ticks, 50ms), so a few lucky samples can't make it too tight
+#define PACKET_RTO_MIN_TICKS 5
+
+// The host sends its link timeout in each PING in units of `1 << PACKET_TIMEOUT_SHIFT` link ticks, to fit in a byte
+#define PACKET_TIMEOUT_SHIFT 2
 
 /**
  * Enum of ids of packets that can be sent or received.
  */
 typedef enum {
-    /** Used to begin pairing. Contains the RNG seed for the order of spawning the pieces */
+    /** Used to begin pairing. Contains the RNG seed for the order of spawning the pieces (4 bytes) */
     PAIRING_PACKET,
 
-    /** Acknowledgment for PAIRING_PACKET */
+    /** Acknowledgment for PAIRING_PACKET (reliable) */
     PAIRING_ACK_PACKET,
 
-    /** Empty packet sent periodically to confirm both boards are still in communication. Expect a PONG_PACKET in response */
+    /**
+     * Sent every heartbeat by the host to confirm both boards are still in communication. Expect a PONG_PACKET in response.
+     * Contains the total number of lines the sender has cleared (2 bytes), in case a LINE_CLEAR_PACKET was lost,
+     * the low byte of the link tick it was sent on (1 byte), and the host's link timeout (1 byte, see `PACKET_TIMEOUT_SHIFT`).
+     */
     PING_PACKET,
 
-    /** Sent in acknowledgment for PING_PACKET */
+    /**
+     * Sent in acknowledgment for PING_PACKET, contains the total number of lines cleared (2 bytes),
+     * and the tick byte of the PING it answers (1 byte), so the host can measure the round trip time.
+     */
     PONG_PACKET,
 
-    /** Used to indicate that X amount of lines have been cleared */
+    /** Sent when lines have been cleared, contains the total number of lines the sender has cleared (2 bytes) */
     LINE_CLEAR_PACKET,
 
-    /** Used when one of the players has died */
+    /** Used when one of the players has died, contains their final number of lines cleared (2 bytes, reliable) */
     DIE_PACKET,
 
-    /** Acknowledgement of DIE_PACKET */
-    DIE_ACK_PACKET,
+    /** Acknowledgement of a reliable packet, contains its sequence number (1 byte). Handled by `packet_get` */
+    ACK_PACKET,
 
-    /**
-     * Placeholder to determine max value of this enum. Not an actual packet!
-     * There should not be more than `PACKET_ID_MAX_VAL` packet ids.
-     * If there are, more bits should be assigned for the ID.
-     */
+    /** Placeholder to determine max value of this enum. Not an actual packet! */
     _PACKET_COUNT,
 } PacketID;
 
 /**
- * Defined structure for a packet sent/received by IR.
- * The size of this structure is equal to one byte: `sizeof(uint8_t)`.
- *
- * This is a union providing two ways to access the data:
- * - `id` and `data` are defined as bitfields, to access these parts of the byte.
- * - `raw` is used to access the raw uint8_t byte.
+ * A packet sent/received by IR, as one record of a frame.
+ * Only the low bytes of `data` that fit in the packet's payload are sent.
  */
-typedef union {
-    struct {
-        uint8_t id : PACKET_ID_LEN;
-        uint8_t data : PACKET_DATA_LEN;
-    };
-    uint8_t raw;
+typedef struct {
+    PacketID id;
+
+    /** sequence number of a reliable packet, set by `packet_queue` */
+    uint8_t seq;
+
+    uint32_t data;
 } packet_t;
 
-// /**
-//  * @brief Decode the given `byte` into the `packet`.
-//  * @param byte The unmodified uint8_t received from the IR sensor.
-//  * @param packet Pass by reference `packet` object.
-//  * @return Whether the byte that was decoded is valid.
-//  *         i.e. the packet ID received is valid.
-//  */
-// bool packet_decode(uint8_t byte, packet_t* packet);
+/** Counts of the packets sent and received, to diagnose a bad IR link */
+typedef struct {
+    /** valid packets received, including acks and retransmissions */
+    uint16_t received;
+
+    /** frames dropped because they were corrupted */
+    uint16_t dropped;
+
+    /** packets with an unknown id, or a payload cut off by the end of the frame */
+    uint16_t invalid;
+
+    /** bytes lost because the receive buffer was full */
+    uint16_t overflows;
 
-// /**
-//  * @brief Encode the given packet into a uint8_t byte to be sent by IR.
-//  * @param packet The packet to be sent
-//  * @return The byte to be sent by the IR transmitter.
-//  */
-// uint8_t packet_encode(packet_t packet);
+    /** reliable packets sent again because they weren't acknowledged in time */
+    uint16_t retransmits;
+
+    /** reliable packets refused by `packet_queue` because every pending slot was waiting to be acknowledged */
+    uint16_t deferred;
+
+    /** PINGs that weren't answered before the next one was sent, and the recent fraction of them (out of 255) */
+    uint16_t pings_missed;
+    uint8_t ping_loss;
+
+    /** round trip time of the last answered PING, the smallest and largest seen, and the smoothed mean and deviation (in link ticks) */
+    uint8_t rtt;
+    uint8_t rtt_min;
+    uint8_t rtt_max;
+    uint8_t srtt;
+    uint8_t rttvar;
+
+    /** the current time between PINGs, and the time without hearing from the other board before the link is lost (in link ticks) */
+    uint8_t heartbeat;
+    uint16_t timeout;
+} packet_stats_t;
+
+/** The state of the receiver, while reading a frame */
+typedef enum {
+    /** waiting for `PACKET_FRAME_SYNC` */
+    FRAME_SYNC,
+
+    /** waiting for the length */
+    FRAME_LEN,
+
+    /** reading the packet bytes */
+    FRAME_BODY,
+
+    /** waiting for the low byte of the checksum */
+    FRAME_CHECKSUM,
+
+    /** waiting for the high byte of the checksum */
+    FRAME_CHECKSUM_HIGH,
+
+    /** a valid frame has been received, its packets are being handled */
+    FRAME_READY,
+} frame_state_t;
+
+/** The frame being received */
+typedef struct {
+    frame_state_t state;
+    uint8_t len;
+    uint8_t pos;
+    uint8_t body[PACKET_FRAME_MAX_LEN];
+    uint16_t checksum;
+} packet_rx_frame_t;
+
+/** Packets queued to be sent in the next frame */
+typedef struct {
+    uint8_t len;
+    uint8_t body[PACKET_FRAME_MAX_LEN];
+} packet_tx_frame_t;
 
 /**
- * @brief Read the next byte from the IR receiver and decode into the given `packet`.
- * @param packet Pass by reference `packet` object for the byte to be decoded into.
- * @return true if a *valid* packet was received from IR and decoded into `packet`.
- * @return false if there wasn't a byte ready to be received, or if an invalid packet was read.
+ * Ring buffer of bytes read from the transport by `packet_poll`, waiting to be decoded by `packet_get`.
+ * Like `packet_tx_ring_t`, the producer and consumer each only write their own index.
+ */
+typedef struct {
+    uint8_t buffer[PACKET_RX_BUFFER_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} packet_rx_ring_t;
+
+/**
+ * Ring buffer of encoded frames waiting to be transmitted, drained by `packet_transmit`.
+ * There is a single producer (`packet_flush`) and a single consumer (`packet_transmit`),
+ * each only writes its own index, so no locking is needed.
+ */
+typedef struct {
+    uint8_t buffer[PACKET_TX_BUFFER_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} packet_tx_ring_t;
+
+/** A reliable packet that has been sent, but not acknowledged */
+typedef struct {
+    packet_t packet;
+
+    /** the link tick it was last sent on */
+    uint16_t sent;
+
+    /** the time until it is sent again is `PACKET_RETRANSMIT_TICKS << backoff` */
+    uint8_t backoff;
+
+    bool active;
+} packet_pending_t;
+
+/** State of the heartbeat, and the round trip time estimate (as in TCP, RFC 6298) */
+typedef struct {
+    /** the link tick the last PING was sent on, and whether it is still waiting for a PONG */
+    uint16_t ping_sent;
+    bool ping_outstanding;
+
+    /** the link tick any packet was last received from the other board on */
+    uint16_t heard;
+
+    /** smoothed round trip time (scaled by 8) and its mean deviation (scaled by 4), valid once a PONG has been received */
+    uint16_t srtt;
+    uint16_t rttvar;
+    bool rtt_valid;
+} packet_heartbeat_t;
+
+/** Everything needed to send and receive packets with the other board */
+typedef struct {
+    const transport_t* transport;
+
+    packet_rx_ring_t rx_ring;
+    packet_rx_frame_t rx_frame;
+    packet_tx_frame_t tx_frame;
+    packet_tx_ring_t tx_ring;
+
+    /** Reliable packets waiting to be acknowledged */
+    packet_pending_t pending[PACKET_MAX_PENDING];
+
+    /** Sequence number of the next reliable packet we send */
+    uint8_t tx_seq;
+
+    /** Sequence number of the next reliable packet we expect, earlier ones are retransmissions we have handled */
+    uint8_t rx_seq;
+
+    /** the link's clock, see `PACKET_TICK_FREQ` */
+    uint16_t tick;
+
+    packet_heartbeat_t heartbeat;
+
+    packet_stats_t stats;
+} packet_link_t;
+
+/**
+ * The link packets are currently sent and received on.
+ * Every function below acts on this link, so a host simulation can switch between the links of several boards.
+ */
+extern packet_link_t* packet_link;
+
+/**
+ * @brief Initialise `link` to send and receive packets on `transport`, and make it the current `packet_link`.
+ */
+void packet_init(packet_link_t* link, const transport_t* transport);
+
+/**
+ * @brief Read the bytes waiting in the transport into the receive buffer, at most `PACKET_RX_BUDGET` per call.
+ */
+void packet_poll(void);
+
+/**
+ * @brief Decode the next packet of a frame received by `packet_poll` into `packet`.
+ * @param packet Pass by reference `packet` object for the packet to be decoded into.
+ * @return true if a *valid* packet was received and decoded into `packet`.
+ * @return false if there are no more packets ready to be handled.
  */
 bool packet_get(packet_t* packet);
 
 /**
- * @brief Encode the given `packet` into a byte and transmit it via IR.
- * @param packet The packet to be encoded and sent
+ * @brief Queue the given `packet` to be sent in the next frame.
+ *        Reliable packets are given a sequence number, and retransmitted by `packet_update` until they are acknowledged.
+ *        Identical unreliable packets are only queued once per frame.
+ * @param packet The packet to be sent
+ * @return false if the packet is reliable and `PACKET_MAX_PENDING` packets are already waiting to be acknowledged.
+ *         It isn't sent, and must be queued again later.
+ */
+bool packet_queue(packet_t packet);
+
+/**
+ * @brief Move the queued packets into the transmit buffer as one frame, if any are queued.
+ *        The frame is dropped if the transmit buffer is full, reliable packets will be retransmitted.
+ */
+void packet_flush(void);
+
+/**
+ * @brief Advance the link's clock by one tick, and queue a retransmission of every reliable packet
+ *        that hasn't been acknowledged within `PACKET_RETRANSMIT_TICKS`. Must be called at `PACKET_TICK_FREQ`.
+ */
+void packet_update(void);
+
+/**
+ * @brief Write as many bytes from the transmit buffer to the transport as it can take without waiting.
  */
-void packet_send(packet_t packet);
+void packet_transmit(void);
+
+/**
+ * @brief Returns the counts of the packets sent and received on the current link, and its round trip time.
+ */
+const packet_stats_t* packet_stats(void);
+
+/**
+ * @brief Whether a packet has been received from the other board within the link timeout,
+ *        which is `PACKET_HEARTBEAT_MISSES` heartbeats plus the round trip timeout.
+ */
+bool packet_link_alive(void);
+
+/**
+ * @brief Forget every packet waiting to be sent or acknowledged, and which packets have been received.
+ *        Used when pairing, so nothing from the previous round is sent or handled in the new one.
+ */
+void packet_reset(void);
 
 /**
  * @brief Contains the functionality to handle a received packet.
@@ -110,13 +345,38 @@ void packet_send(packet_t packet);
 void handle_packet(packet_t packet);
 
 /**
- * @brief Checks to see if we should send the die packet.
- * Additionally, checks if both players are dead, then the game is over.
+ * @brief Send the Ping packet once the heartbeat has passed, if game_data->host is true (if we were the board that sent the Pairing).
+ *        The heartbeat adapts to how many PINGs are answered, see `PACKET_HEARTBEAT_MIN_TICKS`.
+ */
+void check_ping_pong_packet(void);
+
+/**
+ * @brief Queue the Die packet once we have died, if it hasn't been queued yet.
+ *        It is reliable, so it waits here until a pending slot is free.
  */
 void check_die_packet(void);
 
 /**
- * @brief Send the Ping packet, if game_data->host is true (if we were the board that sent the Pairing)
+ * @brief Send the Pairing packet with our seed, and become the host. The link is reset first,
+ *        so nothing from the previous round is sent or handled in the new one.
  */
-void check_ping_pong_packet(void);
+void send_pairing_packet(void);
+
+/**
+ * @brief Tell the other board what happened in an update of our engine.
+ *        Queues a Line Clear packet if we cleared lines, and if we died, moves to the dead state and queues our Die packet.
+ */
+void handle_engine_event(engine_event_t event);
+
+/**
+ * @brief Drain the receiver and handle every packet that has arrived, then advance the link's clock
+ *        and send every packet queued since the last call as one frame. Must be called at `PACKET_TICK_FREQ`.
+ */
+void packet_process(void);
+
+/**
+ * @brief Check whether the game is over, send the Ping packet and pause if the other board stops responding,
+ *        and queue our Die packet if it couldn't be queued when we died. Called by the send packet task.
+ */
+void check_packets(void);
 #endif  // PACKET_H
\ No newline at end of file
@@ -6,297 +6,483 @@
 
 #include "piece.h"
 
-#include <navswitch.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "board.h"
-#include "game_data.h"
 
 // Simply combines 4 params (each param should just be be 4 bits) into a single binary string, for easier visualation.
 #define BINARY(a, b, c, d) 0b##a##b##c##d
 
+// The 4 bits of `row` (0 = top) of a 16 bit pattern, with the left most column in the highest bit.
+#define PATTERN_ROW(pattern, row) (((pattern) >> (12 - 4 * (row))) & 0xF)
+
+// Reverse a 4 bit value, so the left most column ends up in bit 0 (the layout used by `board_t`).
+#define REVERSE_NIBBLE(n) ((((n) & 0x1) << 3) | (((n) & 0x2) << 1) | (((n) & 0x4) >> 1) | (((n) & 0x8) >> 3))
+
+// Index of the lowest/highest set bit of a non-zero 4 bit value.
+#define LOWEST_BIT(n)  (((n) & 0x1) ? 0 : ((n) & 0x2) ? 1 : ((n) & 0x4) ? 2 : 3)
+#define HIGHEST_BIT(n) (((n) & 0x8) ? 3 : ((n) & 0x4) ? 2 : ((n) & 0x2) ? 1 : 0)
+
+// Row mask of `row` in the layout used by `board_t`.
+#define SHAPE_ROW(pattern, row) REVERSE_NIBBLE(PATTERN_ROW(pattern, row))
+
+// Mask of every column that has a filled tile, in any row.
+#define SHAPE_COLUMNS(pattern) (SHAPE_ROW(pattern, 0) | SHAPE_ROW(pattern, 1) | SHAPE_ROW(pattern, 2) | SHAPE_ROW(pattern, 3))
+
+// Mask of every row that has a filled tile.
+#define SHAPE_ROWS(pattern)                 \
+    ((PATTERN_ROW(pattern, 0) ? 0x1 : 0) |  \
+     (PATTERN_ROW(pattern, 1) ? 0x2 : 0) |  \
+     (PATTERN_ROW(pattern, 2) ? 0x4 : 0) |  \
+     (PATTERN_ROW(pattern, 3) ? 0x8 : 0))
+
+// The lowest row of column `x` (0 = left most) that has a filled tile, 0 if the column is empty.
+#define PATTERN_COLUMN_BIT(x) (0x8 >> (x))
+#define COLUMN_BOTTOM(pattern, x)                            \
+    ((PATTERN_ROW(pattern, 3) & PATTERN_COLUMN_BIT(x)) ? 3 : \
+     (PATTERN_ROW(pattern, 2) & PATTERN_COLUMN_BIT(x)) ? 2 : \
+     (PATTERN_ROW(pattern, 1) & PATTERN_COLUMN_BIT(x)) ? 1 : 0)
+
+// Expands a 16 bit pattern into a `piece_shape_t` initialiser at compile time.
+#define PIECE_SHAPE(pattern)                                                                                           \
+    {                                                                                                                  \
+        .rows = {SHAPE_ROW(pattern, 0), SHAPE_ROW(pattern, 1), SHAPE_ROW(pattern, 2), SHAPE_ROW(pattern, 3)},          \
+        .min_x = LOWEST_BIT(SHAPE_COLUMNS(pattern)),                                                                   \
+        .max_x = HIGHEST_BIT(SHAPE_COLUMNS(pattern)),                                                                  \
+        .min_y = LOWEST_BIT(SHAPE_ROWS(pattern)),                                                                      \
+        .max_y = HIGHEST_BIT(SHAPE_ROWS(pattern)),                                                                     \
+        .row_bits = SHAPE_ROWS(pattern),                                                                               \
+        .bottom = {COLUMN_BOTTOM(pattern, 0), COLUMN_BOTTOM(pattern, 1),                                               \
+                   COLUMN_BOTTOM(pattern, 2), COLUMN_BOTTOM(pattern, 3)},                                              \
+    }
+
 /**
  * Precalculated tetris pieces and their rotations. (see image: https://harddrop.com/wiki/File:SRS-pieces.png)
  * Every piece always has exactly 4 points, so we define each piece on a 4x4 grid.
- * This fits nicely (4x4 = 16 bits) into a uint16_t.
+ * This fits nicely (4x4 = 16 bits) into a uint16_t, which is expanded into row masks and
+ * bounding box extents at compile time so collision checks never need to decode it.
  */
-const uint16_t pieces[PIECES_COUNT][PIECE_NUM_ROTATIONS] = {
+const PIECE_FLASH piece_shape_t pieces[PIECES_COUNT][PIECE_NUM_ROTATIONS] = {
     // clang-format off
 
     // I Piece
     {
-        BINARY( 0000,
-                1111,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 0000,
+                            1111,
+                            0000,
+                            0000)),
         
-        BINARY( 0010,
-                0010,
-                0010,
-                0010),
-
-        BINARY( 0000,
-                0000,
-                1111,
-                0000),
-
-        BINARY( 0100,
-                0100,
-                0100,
-                0100),
+        PIECE_SHAPE(BINARY( 0010,
+                            0010,
+                            0010,
+                            0010)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            0000,
+                            1111,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0100,
+                            0100,
+                            0100,
+                            0100)),
     },
 
     // J Piece
     {
-        BINARY( 1000,
-                1110,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 1000,
+                            1110,
+                            0000,
+                            0000)),
         
-        BINARY( 0110,
-                0100,
-                0100,
-                0000),
-
-        BINARY( 0000,
-                1110,
-                0010,
-                0000),
-
-        BINARY( 0100,
-                0100,
-                1100,
-                0000),
+        PIECE_SHAPE(BINARY( 0110,
+                            0100,
+                            0100,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            1110,
+                            0010,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0100,
+                            0100,
+                            1100,
+                            0000)),
     },
 
     // L Piece
     {
-        BINARY( 0010,
-                1110,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 0010,
+                            1110,
+                            0000,
+                            0000)),
         
-        BINARY( 0100,
-                0100,
-                0110,
-                0000),
-
-        BINARY( 0000,
-                1110,
-                1000,
-                0000),
-
-        BINARY( 1100,
-                0100,
-                0100,
-                0000),
+        PIECE_SHAPE(BINARY( 0100,
+                            0100,
+                            0110,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            1110,
+                            1000,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 1100,
+                            0100,
+                            0100,
+                            0000)),
     },
     
     // O Piece
     {
-        BINARY( 0110,
-                0110,
-                0000,
-                0000),
-
-        BINARY( 0110,
-                0110,
-                0000,
-                0000),
-
-        BINARY( 0110,
-                0110,
-                0000,
-                0000),
-
-        BINARY( 0110,
-                0110,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 0110,
+                            0110,
+                            0000,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0110,
+                            0110,
+                            0000,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0110,
+                            0110,
+                            0000,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0110,
+                            0110,
+                            0000,
+                            0000)),
     },
 
     // S Piece
     {
-        BINARY( 0110,
-                1100,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 0110,
+                            1100,
+                            0000,
+                            0000)),
         
-        BINARY( 0100,
-                0110,
-                0010,
-                0000),
-
-        BINARY( 0000,
-                0110,
-                1100,
-                0000),
-
-        BINARY( 1000,
-                1100,
-                0100,
-                0000),
+        PIECE_SHAPE(BINARY( 0100,
+                            0110,
+                            0010,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            0110,
+                            1100,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 1000,
+                            1100,
+                            0100,
+                            0000)),
     },
 
     // T Piece
     {
-        BINARY( 0100,
-                1110,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 0100,
+                            1110,
+                            0000,
+                            0000)),
         
-        BINARY( 0100,
-                0110,
-                0100,
-                0000),
-
-        BINARY( 0000,
-                1110,
-                0100,
-                0000),
-
-        BINARY( 0100,
-                1100,
-                0100,
-                0000),
+        PIECE_SHAPE(BINARY( 0100,
+                            0110,
+                            0100,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            1110,
+                            0100,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0100,
+                            1100,
+                            0100,
+                            0000)),
     },
 
     // Z Piece
     {
-        BINARY( 1100,
-                0110,
-                0000,
-                0000),
+        PIECE_SHAPE(BINARY( 1100,
+                            0110,
+                            0000,
+                            0000)),
         
-        BINARY( 0010,
-                0110,
-                0100,
-                0000),
-
-        BINARY( 0000,
-                1100,
-                0110,
-                0000),
-
-        BINARY( 0100,
-                1100,
-                1000,
-                0000),
+        PIECE_SHAPE(BINARY( 0010,
+                            0110,
+                            0100,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0000,
+                            1100,
+                            0110,
+                            0000)),
+
+        PIECE_SHAPE(BINARY( 0100,
+                            1100,
+                            1000,
+                            0000)),
     },
 
     // clang-format on
 };
 
 /**
- * @brief Randomly shuffle the itmes in the given array.
+ * @brief xorshift32, the random number generator used to shuffle the bags.
+ * @param state Pass by reference the state of the generator, must not be 0.
  */
-static void shuffle_array(uint8_t* arr, size_t size)
+static uint32_t piece_rng_next(uint32_t* state)
 {
-    for (uint8_t i = 0; i < size; i++)
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/**
+ * @brief Returns a uniformly distributed random number less than `n` (1 to 128).
+ *        Takes just enough of the top bits to cover `n`, and tries again if the result is too large,
+ *        so unlike `% n` no result is more likely than another.
+ */
+static uint8_t piece_rng_below(uint32_t* state, uint8_t n)
+{
+    uint8_t bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+
+    if (bits == 0)
+        return 0;
+
+    uint8_t result;
+    do
+        result = piece_rng_next(state) >> (32 - bits);
+    while (result >= n);
+
+    return result;
+}
+
+/**
+ * @brief Add a new bag of every piece, in a random order, to the end of the queue.
+ *        Shuffled with a Fisher-Yates shuffle, so every order is equally likely.
+ */
+static void piece_generator_deal_bag(piece_generator_t* generator)
+{
+    uint8_t bag[PIECES_COUNT];
+    for (uint8_t i = 0; i < PIECES_COUNT; i++)
+        bag[i] = i;
+
+    for (uint8_t i = PIECES_COUNT - 1; i > 0; i--)
     {
-        uint8_t j = rand() % size;
-        uint8_t temp = arr[i];
-        arr[i] = arr[j];
-        arr[j] = temp;
+        uint8_t j = piece_rng_below(&generator->rng, i + 1);
+        uint8_t temp = bag[i];
+        bag[i] = bag[j];
+        bag[j] = temp;
     }
+
+    for (uint8_t i = 0; i < PIECES_COUNT; i++)
+        generator->queue[(uint8_t)(generator->head + generator->count++) & (PIECE_QUEUE_LEN - 1)] = bag[i];
 }
 
 /**
- * @brief Spawn/initialise the next tetris piece into `current_piece`.
- * @param current_piece Pass by reference the pointer to the current_piece.
- * @return Whether the piece spawned at a valid position. If this function returns
- *         `false`, then the game is over.
+ * @brief Initialise the generator with an empty queue, bags are dealt when they are first needed.
+ * @param seed Seed used to randomise the order, the same seed always gives the same order.
  */
-bool piece_generate_next(piece_t** current_piece)
+void piece_generator_init(piece_generator_t* generator, uint32_t seed)
 {
-    static uint8_t _nextPieceId = 0;
+    // mix the seed (the finaliser of MurmurHash3), so consecutive seeds don't start with similar bags
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6B;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35;
+    seed ^= seed >> 16;
+
+    // xorshift32 would only ever return 0 from a state of 0
+    generator->rng = seed ? seed : 0x9E3779B9;
+    generator->head = 0;
+    generator->count = 0;
+}
 
-    // On first call, randomise the indexes used for the `pieces` array.
-    static bool init = false;
-    static uint8_t pieceIdx[PIECES_COUNT] = {0, 1, 2, 3, 4, 5, 6};
-    if (!init)
-    {
-        shuffle_array(pieceIdx, ARRAY_SIZE(pieceIdx));
+/**
+ * @brief Returns the index into the `pieces` array of an upcoming piece, without removing it.
+ *        Deals new bags if the queue doesn't reach that far yet.
+ * @param ahead How far ahead to look, 0 is the next piece to spawn. Must be less than `PIECE_LOOKAHEAD`.
+ */
+uint8_t piece_generator_peek(piece_generator_t* generator, uint8_t ahead)
+{
+    while (generator->count <= ahead)
+        piece_generator_deal_bag(generator);
 
-        // On first run we malloc the current_piece pointer, and continue to reuse it for the rest of the program
-        *current_piece = malloc(sizeof(piece_t));
-        init = true;
-    }
+    return generator->queue[(uint8_t)(generator->head + ahead) & (PIECE_QUEUE_LEN - 1)];
+}
 
-    piece_t* piece = *current_piece;
+/**
+ * @brief Spawn/initialise the next tetris piece into `piece`.
+ * @param generator The generator used to choose the next piece.
+ * @param board The board the piece is spawned on.
+ * @param piece The piece to be (re)initialised as the next piece.
+ * @return Whether the piece spawned at a valid position. If this function returns
+ *         `false`, then the game is over.
+ */
+bool piece_generate_next(piece_generator_t* generator, board_t* board, piece_t* piece)
+{
     memset(piece, 0, sizeof(piece_t));
 
     // set values
-    piece->idx = pieceIdx[_nextPieceId];
+    piece->idx = piece_generator_peek(generator, 0);
     piece->orientation = ORIENTATION_NORTH;
-    piece->pos = (tinygl_point_t){
-        .x = 1,  // offset by 1 so pieces spawn centered
-        .y = 0,
+    piece->pos = (point_t){
+        .x = PIECE_SPAWN_X,
+        .y = PIECE_SPAWN_Y,
     };
 
-    _nextPieceId = (_nextPieceId + 1) % ARRAY_SIZE(pieces);
+    generator->head = (generator->head + 1) & (PIECE_QUEUE_LEN - 1);
+    generator->count--;
 
-    // check if the new current_piece pos is valid
+    // check if the new piece pos is valid
     bool valid_pos = board_valid_position(
-        game_data->board,
+        board,
         piece,
         piece->pos.x,
         piece->pos.y,
         piece->orientation);
 
+    if (valid_pos)
+        board_mark_piece_dirty(board, piece);
+
     return valid_pos;
 }
 
 /**
- * @brief Returns a tinygl_point_t array for the given orientation of this piece.
+ * @brief Writes the points of the given orientation of this piece, at position (`x`, `y`), into `points`.
+ * @param points Caller provided array that receives the `PIECE_NUM_POINTS` points of the piece.
  */
-const tinygl_point_t* piece_get_points(piece_t* piece, uint8_t x, uint8_t y, orientation_t orientation)
+void piece_get_points(const piece_t* piece, int8_t x, int8_t y, orientation_t orientation, point_t points[PIECE_NUM_POINTS])
 {
-    static tinygl_point_t points[PIECE_NUM_POINTS];
-    uint16_t pattern = pieces[piece->idx][orientation];
-
-    // As stated above, each tetris piece is defined on a 4x4 grid.
-    // We start with the left most bit, and continually shift it to the right, to test if the bit
-    // in the given position is 1, indicating a point.
-    // think of this uint16_t as groupings of 4 bits: 4 columns and 4 rows (see above how the pieces array is defined)
-
-    uint16_t test_bit = 0b1000000000000000;
+    const PIECE_FLASH piece_shape_t* shape = &pieces[piece->idx][orientation];
 
+    // Walk each row mask of the piece, bit `column` is set if there is a point in that column.
     uint8_t i = 0;
-    for (uint8_t column = 0; column < PIECE_GRID_SIZE; column++)
+    for (uint8_t row = shape->min_y; row <= shape->max_y; row++)
     {
-        for (uint8_t row = 0; row < PIECE_GRID_SIZE; row++)
+        uint8_t mask = shape->rows[row];
+        for (uint8_t column = 0; mask; column++, mask >>= 1)
         {
-            // if there is a 1 in this bit pos
-            if (pattern & test_bit)
+            if (mask & 1)
             {
-                points[i].x = row + x;
-                points[i].y = column + y;
+                points[i].x = column + x;
+                points[i].y = row + y;
                 i++;
             }
-
-            test_bit >>= 1;
         }
     }
+}
 
-    return points;
+/**
+ * @brief Returns the mask of the tiles covered by the piece in row `y` of the board.
+ *        Uses the same layout as `board_t.rows`.
+ */
+uint8_t piece_row_mask(const piece_t* piece, int8_t y)
+{
+    const PIECE_FLASH piece_shape_t* shape = &pieces[piece->idx][piece->orientation];
+    int8_t row = y - piece->pos.y;
+    if (row < shape->min_y || row > shape->max_y)
+        return 0;
+
+    int8_t x = piece->pos.x;
+    return x >= 0 ? shape->rows[row] << x : shape->rows[row] >> -x;
 }
 
+// Number of wall kicks tried after rotating in place
+#define PIECE_NUM_KICKS 4
+
+// Packs a wall kick offset into a byte, x in the upper nibble and y in the lower nibble.
+// Offsets are written as in the SRS tables, with y pointing up, so y is negated for the board (row 0 is the top).
+#define KICK(x, y) ((uint8_t)((((x) & 0xF) << 4) | ((-(y)) & 0xF)))
+
+// Unpack the signed offsets from a kick, the nibbles are sign extended by the arithmetic shift
+#define KICK_X(kick) ((int8_t)(kick) >> 4)
+#define KICK_Y(kick) ((int8_t)((kick) << 4) >> 4)
+
+/** Which kick table a piece uses, indexed by `piece_t.idx` */
+typedef enum {
+    KICK_CLASS_I,
+    KICK_CLASS_JLSTZ,
+    KICK_CLASS_NONE,  // the O piece looks the same in every orientation, so never needs to kick
+} kick_class_t;
+
+static const PIECE_FLASH uint8_t piece_kick_class[PIECES_COUNT] = {
+    KICK_CLASS_I,      // I
+    KICK_CLASS_JLSTZ,  // J
+    KICK_CLASS_JLSTZ,  // L
+    KICK_CLASS_NONE,   // O
+    KICK_CLASS_JLSTZ,  // S
+    KICK_CLASS_JLSTZ,  // T
+    KICK_CLASS_JLSTZ,  // Z
+};
+
+/**
+ * Super Rotation System wall kicks for clockwise rotations, indexed by kick class and the orientation being rotated from.
+ * The orientations in `pieces` are in clockwise order, so they match the SRS states 0, R, 2 and L.
+ * Each kick from A to B is the negation of the kick from B to A, so the counter-clockwise kicks are not stored:
+ * rotating counter-clockwise from orientation `o` uses the clockwise kicks from `o - 1`, negated.
+ */
+static const PIECE_FLASH uint8_t piece_kicks[KICK_CLASS_NONE][PIECE_NUM_ROTATIONS][PIECE_NUM_KICKS] = {
+    // clang-format off
+    [KICK_CLASS_I] = {
+        { KICK(-2, 0), KICK( 1, 0), KICK(-2,-1), KICK( 1, 2) },  // 0 -> R
+        { KICK(-1, 0), KICK( 2, 0), KICK(-1, 2), KICK( 2,-1) },  // R -> 2
+        { KICK( 2, 0), KICK(-1, 0), KICK( 2, 1), KICK(-1,-2) },  // 2 -> L
+        { KICK( 1, 0), KICK(-2, 0), KICK( 1,-2), KICK(-2, 1) },  // L -> 0
+    },
+    [KICK_CLASS_JLSTZ] = {
+        { KICK(-1, 0), KICK(-1, 1), KICK( 0,-2), KICK(-1,-2) },  // 0 -> R
+        { KICK( 1, 0), KICK( 1,-1), KICK( 0, 2), KICK( 1, 2) },  // R -> 2
+        { KICK( 1, 0), KICK( 1, 1), KICK( 0,-2), KICK( 1,-2) },  // 2 -> L
+        { KICK(-1, 0), KICK(-1,-1), KICK( 0, 2), KICK(-1, 2) },  // L -> 0
+    },
+    // clang-format on
+};
+
 /**
- * @brief Attempt to rotate the piece clockwise.
+ * @brief Attempt to rotate the piece, trying the SRS wall kicks if it doesn't fit in place.
+ * @param clockwise Rotate clockwise if true, otherwise counter-clockwise.
  * @return true if the piece was succesfully rotated.
- * @return false if the piece was not able to be rotated (e.g. would collide with a wall).
+ * @return false if the piece was not able to be rotated (e.g. every kick would collide with a wall).
  */
-bool piece_rotate(piece_t* piece)
+bool piece_rotate(board_t* board, piece_t* piece, bool clockwise)
 {
-    orientation_t new_orientation = (piece->orientation + 1) % PIECE_NUM_ROTATIONS;
+    orientation_t new_orientation = (piece->orientation + (clockwise ? 1 : PIECE_NUM_ROTATIONS - 1)) % PIECE_NUM_ROTATIONS;
+    int8_t x = piece->pos.x;
+    int8_t y = piece->pos.y;
+
+    bool is_valid = board_valid_position(board, piece, x, y, new_orientation);
+
+    kick_class_t kick_class = piece_kick_class[piece->idx];
+    if (!is_valid && kick_class != KICK_CLASS_NONE)
+    {
+        // counter-clockwise kicks are the clockwise kicks from the new orientation, in the opposite direction
+        const PIECE_FLASH uint8_t* kicks = piece_kicks[kick_class][clockwise ? piece->orientation : new_orientation];
+        int8_t sign = clockwise ? 1 : -1;
+        for (uint8_t i = 0; i < PIECE_NUM_KICKS && !is_valid; i++)
+        {
+            x = piece->pos.x + sign * KICK_X(kicks[i]);
+            y = piece->pos.y + sign * KICK_Y(kicks[i]);
+            is_valid = board_valid_position(board, piece, x, y, new_orientation);
+        }
+    }
 
-    bool is_valid = board_valid_position(game_data->board, piece, piece->pos.x, piece->pos.y, new_orientation);
     if (!is_valid)
         return false;
 
+    // redraw the rows the piece has left, and the rows it now covers
+    board_mark_piece_dirty(board, piece);
+    piece->pos.x = x;
+    piece->pos.y = y;
     piece->orientation = new_orientation;
+    board_mark_piece_dirty(board, piece);
     return true;
 }
 
@@ -305,7 +491,7 @@ bool piece_rotate(piece_t* piece)
  * @return true if the piece was successfully moved.
  * @return false if the piece was not able to be moved in the given direction (e.g. would collide a wall).
  */
-bool piece_move(piece_t* piece, direction_t direction)
+bool piece_move(board_t* board, piece_t* piece, direction_t direction)
 {
     int8_t x = piece->pos.x;
     int8_t y = piece->pos.y;
@@ -333,24 +519,14 @@ bool piece_move(piece_t* piece, direction_t direction)
     }
 
     // Check this new position is valid
-    bool is_valid = board_valid_position(game_data->board, piece, x, y, piece->orientation);
+    bool is_valid = board_valid_position(board, piece, x, y, piece->orientation);
     if (!is_valid)
         return false;
 
+    // redraw the rows the piece has left, and the rows it now covers
+    board_mark_piece_dirty(board, piece);
     piece->pos.x = x;
     piece->pos.y = y;
+    board_mark_piece_dirty(board, piece);
     return true;
-}
-
-/**
- * @brief Draws the given piece on the LED matrix.
- */
-void piece_draw(piece_t* piece)
-{
-    const tinygl_point_t* points = piece_get_points(piece, piece->pos.x, piece->pos.y, piece->orientation);
-    for (uint8_t i = 0; i < PIECE_NUM_POINTS; i++)
-    {
-        tinygl_point_t point = points[i];
-        tinygl_draw_point(point, 1);
-    }
 }
\ No newline at end of file
@@ -8,13 +8,26 @@
 #define PIECE_H
 
 #include <stdbool.h>
-#include <tinygl.h>
+#include <stdint.h>
 
 #define PIECES_COUNT        7  // total number of tetris pieces
 #define PIECE_NUM_ROTATIONS 4  // each piece has precalculated 4 rotations
 #define PIECE_NUM_POINTS    4  // each piece is defined with 4 pixel points
 #define PIECE_GRID_SIZE     4  // we define each piece's points on a 4x4 grid.
 
+// Position new pieces are spawned at, offset by 1 so pieces spawn centered
+#define PIECE_SPAWN_X 1
+#define PIECE_SPAWN_Y 0
+
+/** A point on the board. Signed, so relative and off-board positions can be represented. */
+typedef struct {
+    int8_t x;
+    int8_t y;
+} point_t;
+
+/** Declared in board.h, the pieces are moved around on a board */
+struct board;
+
 typedef enum {
     DIRECTION_UP,
     DIRECTION_DOWN,
@@ -29,44 +42,118 @@ typedef enum {
     ORIENTATION_EAST
 } orientation_t;
 
+/**
+ * Precomputed collision data for one orientation of a tetris piece.
+ * Row masks use the same layout as `board_t`: bit `x` is set if column `x` of the 4x4 grid is filled.
+ */
+typedef struct {
+    /** row masks of the piece's 4x4 grid, row 0 is the top of the grid */
+    uint8_t rows[PIECE_GRID_SIZE];
+
+    /** bounding box of the filled tiles within the 4x4 grid (inclusive) */
+    uint8_t min_x;
+    uint8_t max_x;
+    uint8_t min_y;
+    uint8_t max_y;
+
+    /** bit `row` is set if that row of the 4x4 grid has a filled tile */
+    uint8_t row_bits;
+
+    /** the lowest filled row of each column of the 4x4 grid, only valid for columns `min_x` to `max_x` */
+    uint8_t bottom[PIECE_GRID_SIZE];
+} piece_shape_t;
+
+// The AVR copies constant data into SRAM unless it is placed in flash, so the pieces table is read through `__flash`.
+#ifdef __AVR__
+#define PIECE_FLASH __flash
+#else
+#define PIECE_FLASH
+#endif
+
+/**
+ * Precalculated tetris pieces and their rotations, indexed by `piece_t.idx` and `orientation_t`.
+ * Kept in flash on the UCFK4, so pointers into it must be declared `const PIECE_FLASH piece_shape_t*`.
+ */
+extern const PIECE_FLASH piece_shape_t pieces[PIECES_COUNT][PIECE_NUM_ROTATIONS];
+
 /** Represents a tetris piece (tetromino) */
 typedef struct
 {
     uint8_t idx;
-    tinygl_point_t pos;
+    point_t pos;
     orientation_t orientation;
 } piece_t;
 
+// Size of the ring buffer of upcoming pieces, must be a power of 2 no larger than 256
+#define PIECE_QUEUE_LEN 16
+
+// Number of upcoming pieces that can be peeked at. Bags are only dealt once a piece past the end of the queue is needed,
+// so there is always room for a whole bag.
+#define PIECE_LOOKAHEAD (PIECE_QUEUE_LEN - PIECES_COUNT + 1)
+
 /**
- * @brief Spawn/initialise the next tetris piece into `current_piece`.
- * @param current_piece Pass by reference the pointer to the current_piece.
+ * State used to choose the order that pieces spawn in. Pieces are dealt from "bags" of all 7 pieces,
+ * each shuffled with a xorshift32 random number generator, so the same seed always gives the same order.
+ */
+typedef struct {
+    /** state of the random number generator, never 0 */
+    uint32_t rng;
+
+    /** ring buffer of indexes into the `pieces` array of the upcoming pieces, the next piece is at `head` */
+    uint8_t queue[PIECE_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+} piece_generator_t;
+
+/**
+ * @brief Initialise the generator with an empty queue, bags are dealt when they are first needed.
+ * @param seed Seed used to randomise the order, the same seed always gives the same order.
+ */
+void piece_generator_init(piece_generator_t* generator, uint32_t seed);
+
+/**
+ * @brief Returns the index into the `pieces` array of an upcoming piece, without removing it.
+ *        Deals new bags if the queue doesn't reach that far yet.
+ * @param ahead How far ahead to look, 0 is the next piece to spawn. Must be less than `PIECE_LOOKAHEAD`.
+ */
+uint8_t piece_generator_peek(piece_generator_t* generator, uint8_t ahead);
+
+/**
+ * @brief Spawn/initialise the next tetris piece into `piece`.
+ * @param generator The generator used to choose the next piece.
+ * @param board The board the piece is spawned on.
+ * @param piece The piece to be (re)initialised as the next piece.
  * @return Whether the piece spawned at a valid position. If this function returns
  *         `false`, then the game is over.
  */
-bool piece_generate_next(piece_t** current_piece);
+bool piece_generate_next(piece_generator_t* generator, struct board* board, piece_t* piece);
+
+/**
+ * @brief Writes the points of the given orientation of this piece, at position (`x`, `y`), into `points`.
+ * @param points Caller provided array that receives the `PIECE_NUM_POINTS` points of the piece.
+ */
+void piece_get_points(const piece_t* piece, int8_t x, int8_t y, orientation_t orientation, point_t points[PIECE_NUM_POINTS]);
 
 /**
- * @brief Returns a tinygl_point_t array for the given orientation of this piece.
+ * @brief Returns the mask of the tiles covered by the piece in row `y` of the board.
+ *        Uses the same layout as `board_t.rows`.
  */
-const tinygl_point_t* piece_get_points(piece_t* piece, uint8_t x, uint8_t y, orientation_t orientation);
+uint8_t piece_row_mask(const piece_t* piece, int8_t y);
 
 /**
  * @brief Attempt to move the piece in the given direction.
  * @return true if the piece was successfully moved.
  * @return false if the piece was not able to be moved in the given direction (e.g. would collide a wall).
  */
-bool piece_move(piece_t* piece, direction_t direction);
+bool piece_move(struct board* board, piece_t* piece, direction_t direction);
 
 /**
- * @brief Attempt to rotate the piece clockwise.
+ * @brief Attempt to rotate the piece. If it doesn't fit in place, the Super Rotation System wall kicks
+ *        are tried in order, and the piece is moved to the first that fits.
+ * @param clockwise Rotate clockwise if true, otherwise counter-clockwise.
  * @return true if the piece was succesfully rotated.
- * @return false if the piece was not able to be rotated (e.g. would collide with a wall).
- */
-bool piece_rotate(piece_t* piece);
-
-/**
- * @brief Draws the given piece on the LED matrix.
+ * @return false if the piece was not able to be rotated (e.g. every kick would collide with a wall).
  */
-void piece_draw(piece_t* piece);
+bool piece_rotate(struct board* board, piece_t* piece, bool clockwise);
 
 #endif  // PIECE_H
\ No newline at end of file
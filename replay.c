@@ -0,0 +1,263 @@
+/** @file replay.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Compact recording of a round, which can be played back through the engine to reproduce it exactly.
+ */
+
+#include "replay.h"
+
+#define REPLAY_MAGIC_0 'T'
+#define REPLAY_MAGIC_1 'R'
+
+// Maximum length of a LEB128 encoded uint32_t
+#define REPLAY_VARINT_MAX_LEN 5
+
+/**
+ * @brief Append bytes to the replay, or set the overflow flag if they don't fit.
+ */
+static bool replay_write(replay_t* replay, const uint8_t* bytes, uint8_t len)
+{
+    if (replay->overflow || replay->len + len > replay->size)
+    {
+        replay->overflow = true;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < len; i++)
+        replay->buffer[replay->len++] = bytes[i];
+
+    return true;
+}
+
+/**
+ * @brief Record an event with the number of ticks since the previous event.
+ */
+static void replay_write_event(replay_t* replay, replay_code_t code, uint32_t tick)
+{
+    uint8_t bytes[1 + REPLAY_VARINT_MAX_LEN];
+    uint8_t len = 0;
+
+    uint32_t delta = tick - replay->last_tick;
+    if (delta < REPLAY_ARG_ESCAPE)
+        bytes[len++] = (code << REPLAY_ARG_LEN) | delta;
+    else
+    {
+        // escape, the rest of the delta follows as a varint
+        bytes[len++] = (code << REPLAY_ARG_LEN) | REPLAY_ARG_ESCAPE;
+        delta -= REPLAY_ARG_ESCAPE;
+        do
+        {
+            uint8_t byte = delta & 0x7F;
+            delta >>= 7;
+            bytes[len++] = byte | (delta ? 0x80 : 0);
+        } while (delta);
+    }
+
+    if (replay_write(replay, bytes, len))
+        replay->last_tick = tick;
+}
+
+/**
+ * @brief Record any pieces the engine has spawned since the last call.
+ */
+static void replay_write_pieces(replay_t* replay, const engine_t* engine)
+{
+    while (replay->pieces_recorded < engine->pieces_spawned)
+    {
+        uint8_t byte = (REPLAY_CODE_CONTROL << REPLAY_ARG_LEN) | (engine->current_piece.idx + 1);
+        replay_write(replay, &byte, 1);
+        replay->pieces_recorded++;
+    }
+}
+
+/**
+ * @brief Start recording a new replay into `buffer`, from the engine's state at the start of a round.
+ */
+void replay_start(replay_t* replay, uint8_t* buffer, uint16_t size, const engine_t* engine)
+{
+    uint32_t seed = engine->seed;
+    replay->buffer = buffer;
+    replay->size = size;
+    replay->len = 0;
+    replay->last_tick = engine->ticks;
+    replay->pieces_recorded = 0;
+    replay->overflow = false;
+
+    uint8_t header[REPLAY_HEADER_LEN] = {
+        REPLAY_MAGIC_0,
+        REPLAY_MAGIC_1,
+        REPLAY_VERSION,
+        seed,
+        seed >> 8,
+        seed >> 16,
+        seed >> 24,
+    };
+    replay_write(replay, header, REPLAY_HEADER_LEN);
+    replay_write_pieces(replay, engine);
+}
+
+/**
+ * @brief Record an input at the engine's current tick. Must be called after the input has been applied to `engine`.
+ * @param code An input (`engine_input_t` value).
+ */
+void replay_record(replay_t* replay, replay_code_t code, const engine_t* engine)
+{
+    replay_write_event(replay, code, engine->ticks);
+    replay_write_pieces(replay, engine);
+}
+
+/**
+ * @brief Must be called after every `engine_update`, records the update if it spawned a piece.
+ */
+void replay_update(replay_t* replay, const engine_t* engine)
+{
+    if (replay->pieces_recorded == engine->pieces_spawned)
+        return;
+
+    replay_write_event(replay, REPLAY_CODE_UPDATE, engine->ticks);
+    replay_write_pieces(replay, engine);
+}
+
+/**
+ * @brief Finish the replay with the END event and the number of lines cleared.
+ * @return The length of the finished replay, or 0 if it overflowed the buffer.
+ */
+uint16_t replay_finish(replay_t* replay, const engine_t* engine)
+{
+    uint8_t end[] = {
+        (REPLAY_CODE_CONTROL << REPLAY_ARG_LEN) | REPLAY_CONTROL_END,
+        engine->lines_cleared,
+        engine->lines_cleared >> 8,
+    };
+    replay_write(replay, end, sizeof(end));
+
+    return replay->overflow ? 0 : replay->len;
+}
+
+/**
+ * @brief Start reading a replay.
+ * @param seed Set to the seed the engine should be initialised with.
+ * @return false if the data does not start with a valid header.
+ */
+bool replay_reader_init(replay_reader_t* reader, const uint8_t* data, uint16_t len, uint32_t* seed)
+{
+    reader->data = data;
+    reader->len = len;
+    reader->pos = REPLAY_HEADER_LEN;
+    reader->tick = 0;
+
+    if (len < REPLAY_HEADER_LEN || data[0] != REPLAY_MAGIC_0 || data[1] != REPLAY_MAGIC_1 || data[2] != REPLAY_VERSION)
+        return false;
+
+    *seed = (uint32_t)data[3] | (uint32_t)data[4] << 8 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 24;
+    return true;
+}
+
+/**
+ * @brief Read the next event of the replay.
+ * @return false if the replay ended before the END event.
+ */
+bool replay_reader_next(replay_reader_t* reader, replay_event_t* event)
+{
+    if (reader->pos >= reader->len)
+        return false;
+
+    uint8_t byte = reader->data[reader->pos++];
+    uint8_t code = byte >> REPLAY_ARG_LEN;
+    uint8_t arg = byte & REPLAY_ARG_ESCAPE;
+
+    event->code = code;
+    event->end = false;
+
+    if (code == REPLAY_CODE_CONTROL)
+    {
+        event->tick = reader->tick;
+        if (arg != REPLAY_CONTROL_END)
+        {
+            event->piece_idx = arg - 1;
+            return true;
+        }
+
+        // END, followed by the number of lines cleared
+        if (reader->pos + 2 > reader->len)
+            return false;
+
+        event->end = true;
+        event->lines_cleared = reader->data[reader->pos] | reader->data[reader->pos + 1] << 8;
+        reader->pos += 2;
+        return true;
+    }
+
+    uint32_t delta = arg;
+    if (arg == REPLAY_ARG_ESCAPE)
+    {
+        uint32_t extra = 0;
+        uint8_t shift = 0;
+        uint8_t varint;
+        do
+        {
+            if (reader->pos >= reader->len || shift >= 7 * REPLAY_VARINT_MAX_LEN)
+                return false;
+
+            varint = reader->data[reader->pos++];
+            extra |= (uint32_t)(varint & 0x7F) << shift;
+            shift += 7;
+        } while (varint & 0x80);
+
+        delta += extra;
+    }
+
+    reader->tick += delta;
+    event->tick = reader->tick;
+    event->input = code == REPLAY_CODE_UPDATE ? ENGINE_INPUT_NONE : (engine_input_t)code;
+    return true;
+}
+
+/**
+ * @brief Apply a read event to the engine, updating the engine up to the event's tick first.
+ */
+void replay_apply(engine_t* engine, const replay_event_t* event)
+{
+    if (event->code == REPLAY_CODE_CONTROL)
+        return;
+
+    engine_update_until(engine, event->tick);
+
+    if (event->code != REPLAY_CODE_UPDATE)
+        engine_input(engine, event->input);
+}
+
+/**
+ * @brief Play back a replay through `engine` as fast as possible, and validate that it reproduces
+ *        the recorded pieces and number of lines cleared.
+ */
+replay_result_t replay_verify(engine_t* engine, const uint8_t* data, uint16_t len)
+{
+    replay_reader_t reader;
+    uint32_t seed;
+    if (!replay_reader_init(&reader, data, len, &seed))
+        return REPLAY_BAD_HEADER;
+
+    engine_init(engine, seed);
+
+    uint16_t pieces_read = 0;
+    replay_event_t event;
+    while (replay_reader_next(&reader, &event))
+    {
+        if (event.end)
+            return event.lines_cleared == engine->lines_cleared ? REPLAY_OK : REPLAY_LINES_MISMATCH;
+
+        if (event.code == REPLAY_CODE_CONTROL)
+        {
+            // every recorded piece must be the piece the engine spawned at the same point
+            pieces_read++;
+            if (pieces_read != engine->pieces_spawned || event.piece_idx != engine->current_piece.idx)
+                return REPLAY_PIECE_MISMATCH;
+            continue;
+        }
+
+        replay_apply(engine, &event);
+    }
+
+    return REPLAY_TRUNCATED;
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+/** @file replay.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Compact recording of a round, which can be played back through the engine to reproduce it exactly.
+ *
+ *  A replay is a header followed by a stream of one byte events:
+ *  - header: "TR", version, engine seed (uint32_t, little endian)
+ *  - event: upper `REPLAY_CODE_LEN` bits are the event code, lower `REPLAY_ARG_LEN` bits are its argument.
+ *    For inputs and updates the argument is the number of ticks since the previous event. If it doesn't fit,
+ *    the argument is `REPLAY_ARG_ESCAPE` and the rest of the delta follows as a LEB128 varint.
+ *    An event's tick is the number of times `engine_update` had been called when it happened, the updates
+ *    between events are not recorded, as the engine always does the same thing given the same inputs.
+ *    For control events the argument is the control code: END, or a spawned piece (idx + 1).
+ *  - after END: the number of lines cleared (uint16_t, little endian), used to validate the playback.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#define REPLAY_VERSION 4
+
+/** Size of the header, magic (2 bytes) + version (1 byte) + seed (4 bytes) */
+#define REPLAY_HEADER_LEN 7
+
+/** Together these should sum to 8 bits, see the description above */
+#define REPLAY_CODE_LEN 3
+#define REPLAY_ARG_LEN  5
+
+// equivalent to `2^(REPLAY_ARG_LEN) - 1`, the argument value used to escape a long delta
+#define REPLAY_ARG_ESCAPE ((1 << REPLAY_ARG_LEN) - 1)
+
+/** Event codes, inputs use the value of their `engine_input_t` */
+typedef enum {
+    /** END of the replay, or a spawned piece */
+    REPLAY_CODE_CONTROL = 0,
+
+    /** codes 1 to 6 are inputs, the same values as `engine_input_t` */
+
+    /** the engine has been updated up to this tick, recorded when an update spawned a piece */
+    REPLAY_CODE_UPDATE = 7,
+} replay_code_t;
+
+/** Argument of a `REPLAY_CODE_CONTROL` event */
+#define REPLAY_CONTROL_END 0
+
+/** The result of validating a replay against the engine */
+typedef enum {
+    REPLAY_OK,
+
+    /** the data does not start with a valid header */
+    REPLAY_BAD_HEADER,
+
+    /** the data ended before the END event */
+    REPLAY_TRUNCATED,
+
+    /** the engine spawned a different piece to the one recorded */
+    REPLAY_PIECE_MISMATCH,
+
+    /** the engine cleared a different number of lines to the number recorded */
+    REPLAY_LINES_MISMATCH,
+} replay_result_t;
+
+/** State used while recording a replay into a fixed size buffer */
+typedef struct {
+    uint8_t* buffer;
+    uint16_t size;
+    uint16_t len;
+
+    /** the tick of the last recorded event */
+    uint32_t last_tick;
+
+    /** number of spawned pieces that have been recorded */
+    uint16_t pieces_recorded;
+
+    /** set when an event did not fit in the buffer, the rest of the round is not recorded */
+    bool overflow;
+} replay_t;
+
+/** A decoded event, read from a replay with `replay_reader_next` */
+typedef struct {
+    replay_code_t code;
+
+    /** the input, when `code` is an input */
+    engine_input_t input;
+
+    /** the tick the event happened on */
+    uint32_t tick;
+
+    /** the spawned piece, for a piece control event */
+    uint8_t piece_idx;
+
+    /** whether this is the END event */
+    bool end;
+
+    /** the number of lines cleared, for the END event */
+    uint16_t lines_cleared;
+} replay_event_t;
+
+/** State used while reading a replay */
+typedef struct {
+    const uint8_t* data;
+    uint16_t len;
+    uint16_t pos;
+    uint32_t tick;
+} replay_reader_t;
+
+/**
+ * @brief Start recording a new replay into `buffer`, from the engine's state at the start of a round.
+ */
+void replay_start(replay_t* replay, uint8_t* buffer, uint16_t size, const engine_t* engine);
+
+/**
+ * @brief Record an input at the engine's current tick. Must be called after the input has been applied to `engine`.
+ * @param code An input (`engine_input_t` value).
+ */
+void replay_record(replay_t* replay, replay_code_t code, const engine_t* engine);
+
+/**
+ * @brief Must be called after every `engine_update`, records the update if it spawned a piece.
+ */
+void replay_update(replay_t* replay, const engine_t* engine);
+
+/**
+ * @brief Finish the replay with the END event and the number of lines cleared.
+ * @return The length of the finished replay, or 0 if it overflowed the buffer.
+ */
+uint16_t replay_finish(replay_t* replay, const engine_t* engine);
+
+/**
+ * @brief Start reading a replay.
+ * @param seed Set to the seed the engine should be initialised with.
+ * @return false if the data does not start with a valid header.
+ */
+bool replay_reader_init(replay_reader_t* reader, const uint8_t* data, uint16_t len, uint32_t* seed);
+
+/**
+ * @brief Read the next event of the replay.
+ * @return false if the replay ended before the END event.
+ */
+bool replay_reader_next(replay_reader_t* reader, replay_event_t* event);
+
+/**
+ * @brief Apply a read event to the engine, updating the engine up to the event's tick first.
+ */
+void replay_apply(engine_t* engine, const replay_event_t* event);
+
+/**
+ * @brief Play back a replay through `engine` as fast as possible, and validate that it reproduces
+ *        the recorded pieces and number of lines cleared.
+ */
+replay_result_t replay_verify(engine_t* engine, const uint8_t* data, uint16_t len);
+
+#endif  // REPLAY_H
\ No newline at end of file
@@ -0,0 +1,279 @@
+/** @file replay_tool.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Host tool to play back and validate recorded replays.
+ *
+ *  Usage:
+ *    ./replay_tool file.bin...          validate each replay as fast as possible
+ *    ./replay_tool -r file.bin          play back a replay in real time, drawing the board in the terminal
+ *    ./replay_tool -g games [-s seed]   record random games in memory, then time validating all of them
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "replay.h"
+
+// Size of the buffer used to read or record a single replay
+#define REPLAY_TOOL_BUFFER_SIZE 65535
+
+// Maximum number of ticks in a generated game, so the games stay a reasonable length (1000s)
+#define REPLAY_TOOL_MAX_TICKS 100000
+
+// Chance of an input on each tick of a generated game, out of 256 (about 1.5 inputs per second)
+#define REPLAY_TOOL_INPUT_CHANCE 4
+
+static const char* const replay_results[] = {
+    [REPLAY_OK] = "ok",
+    [REPLAY_BAD_HEADER] = "bad header",
+    [REPLAY_TRUNCATED] = "truncated",
+    [REPLAY_PIECE_MISMATCH] = "piece mismatch",
+    [REPLAY_LINES_MISMATCH] = "lines mismatch",
+};
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Read a whole file into `buffer`.
+ * @return The length of the file, or 0 if it could not be read.
+ */
+static uint16_t read_file(const char* path, uint8_t* buffer, uint16_t size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    size_t len = fread(buffer, 1, size, file);
+    fclose(file);
+    return len;
+}
+
+/**
+ * @brief Draw the board and current piece in the terminal.
+ */
+static void draw_engine(const engine_t* engine, uint32_t tick)
+{
+    printf("\033[H\033[2Jtick %u  lines %u  level %u\n", tick, engine->lines_cleared, engine->level);
+    for (int8_t y = 0; y < BOARD_HEIGHT; y++)
+    {
+        // there is no current piece while waiting for the next piece to spawn
+        uint8_t row = engine->board.rows[y];
+        uint8_t piece = engine->state == ENGINE_STATE_PLAYING ? piece_row_mask(&engine->current_piece, y) : 0;
+        for (uint8_t x = 0; x < BOARD_WIDTH; x++)
+            putchar(piece & BOARD_TILE_BIT(x) ? '@' : row & BOARD_TILE_BIT(x) ? '#' : '.');
+        putchar('\n');
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Play back a replay at the speed it was recorded.
+ */
+static int play_realtime(const uint8_t* data, uint16_t len)
+{
+    replay_reader_t reader;
+    uint32_t seed;
+    if (!replay_reader_init(&reader, data, len, &seed))
+    {
+        fprintf(stderr, "%s\n", replay_results[REPLAY_BAD_HEADER]);
+        return EXIT_FAILURE;
+    }
+
+    engine_t engine;
+    engine_init(&engine, seed);
+    draw_engine(&engine, 0);
+
+    replay_event_t event;
+    while (replay_reader_next(&reader, &event))
+    {
+        if (event.end)
+        {
+            printf("recorded lines %u, played back lines %u\n", event.lines_cleared, engine.lines_cleared);
+            return event.lines_cleared == engine.lines_cleared ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        // update the engine in real time until the tick the event was recorded on, redrawing whenever the board changes
+        while (engine.ticks < event.tick && engine.state != ENGINE_STATE_DEAD)
+        {
+            usleep(1000000 / ENGINE_TICK_FREQ);
+            engine_update(&engine);
+            if (engine.board.dirty_rows)
+            {
+                engine.board.dirty_rows = 0;
+                draw_engine(&engine, engine.ticks);
+            }
+        }
+
+        replay_apply(&engine, &event);
+        draw_engine(&engine, engine.ticks);
+    }
+
+    fprintf(stderr, "%s\n", replay_results[REPLAY_TRUNCATED]);
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Record a game played with random inputs into `buffer`.
+ * @return The length of the replay.
+ */
+static uint16_t record_random_game(uint64_t seed, uint8_t* buffer, uint16_t size)
+{
+    uint64_t rng = seed | 1;
+    engine_t engine;
+    engine_init(&engine, (uint32_t)seed);
+
+    replay_t replay;
+    replay_start(&replay, buffer, size, &engine);
+
+    while (engine.ticks < REPLAY_TOOL_MAX_TICKS && engine.state != ENGINE_STATE_DEAD)
+    {
+        uint64_t r = xorshift64(&rng);
+        if ((r & 0xFF) < REPLAY_TOOL_INPUT_CHANCE)
+        {
+            engine_input_t input = ENGINE_INPUT_LEFT + (r >> 8) % (ENGINE_INPUT_ROTATE_CCW - ENGINE_INPUT_LEFT + 1);
+            engine_input(&engine, input);
+            replay_record(&replay, (replay_code_t)input, &engine);
+        }
+
+        engine_update(&engine);
+        replay_update(&replay, &engine);
+    }
+
+    return replay_finish(&replay, &engine);
+}
+
+/**
+ * @brief Record `num_games` random games, then validate them all and report the playback throughput.
+ */
+static int sweep(uint32_t num_games, uint64_t seed)
+{
+    uint8_t* buffers = NULL;
+    uint16_t* lens = malloc(num_games * sizeof(uint16_t));
+    size_t* offsets = malloc(num_games * sizeof(size_t));
+    if (!lens || !offsets)
+    {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // record the games back to back
+    static uint8_t scratch[REPLAY_TOOL_BUFFER_SIZE];
+    size_t capacity = 0;
+    size_t used = 0;
+    for (uint32_t i = 0; i < num_games; i++)
+    {
+        lens[i] = record_random_game(seed + i, scratch, sizeof(scratch));
+        if (lens[i] == 0)
+        {
+            fprintf(stderr, "game %u did not fit in the buffer\n", i);
+            return EXIT_FAILURE;
+        }
+
+        if (used + lens[i] > capacity)
+        {
+            capacity = (capacity + lens[i]) * 2;
+            buffers = realloc(buffers, capacity);
+            if (!buffers)
+            {
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        memcpy(buffers + used, scratch, lens[i]);
+        offsets[i] = used;
+        used += lens[i];
+    }
+
+    uint32_t failures = 0;
+    engine_t engine;
+    double start = time_now();
+    for (uint32_t i = 0; i < num_games; i++)
+        failures += replay_verify(&engine, buffers + offsets[i], lens[i]) != REPLAY_OK;
+    double elapsed = time_now() - start;
+
+    printf("games:      %u\n", num_games);
+    printf("failures:   %u\n", failures);
+    printf("mean bytes: %.1f\n", (double)used / num_games);
+    printf("elapsed:    %.3f s\n", elapsed);
+    printf("games/s:    %.0f\n", num_games / elapsed);
+
+    free(buffers);
+    free(lens);
+    free(offsets);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    bool realtime = false;
+    uint32_t num_games = 0;
+    uint64_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "rg:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            realtime = true;
+            break;
+
+        case 'g':
+            num_games = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "Usage: %s [-r] file.bin... | -g games [-s seed]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (num_games)
+        return sweep(num_games, seed);
+
+    static uint8_t buffer[REPLAY_TOOL_BUFFER_SIZE];
+    int status = EXIT_SUCCESS;
+    for (int i = optind; i < argc; i++)
+    {
+        uint16_t len = read_file(argv[i], buffer, sizeof(buffer));
+        if (realtime)
+            return play_realtime(buffer, len);
+
+        engine_t engine;
+        replay_result_t result = replay_verify(&engine, buffer, len);
+        // the engine is only initialised once the header has been accepted
+        if (result == REPLAY_BAD_HEADER)
+            printf("%s: %s\n", argv[i], replay_results[result]);
+        else
+            printf("%s: %s (%u lines, %u pieces)\n", argv[i], replay_results[result], engine.lines_cleared, engine.pieces_spawned);
+        if (result != REPLAY_OK)
+            status = EXIT_FAILURE;
+    }
+
+    return status;
+}
@@ -0,0 +1,481 @@
+/** @file sim.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Multi-threaded self-play simulator, used to measure the throughput of the engine on a host machine.
+ *
+ *  Runs a number of independent games spread over a pool of worker threads. Each worker owns a
+ *  range of games and steals games from the other workers once its own range is empty.
+ *  Every game is seeded from its index, so the results are the same regardless of the number of threads.
+ *
+ *  The AI policy's games all share one transposition table, so a position searched in one game is not searched again in another.
+ *
+ *  Usage: ./sim [-g games] [-t threads] [-s seed] [-m max_pieces] [-p random|ai|script:<inputs>] [-d depth] [-w beam_width] [-T table_mb]
+ *  Script inputs are a string of: L (left), R (right), D (down), U (rotate clockwise), C (rotate counter-clockwise), H (hard drop, then a gravity tick), T (gravity tick)
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "engine.h"
+
+#define SIM_MAX_THREADS 256
+
+// Default settings
+#define SIM_DEFAULT_GAMES      100000
+#define SIM_DEFAULT_SEED       1
+#define SIM_DEFAULT_MAX_PIECES 10000
+#define SIM_DEFAULT_TABLE_MB   16
+
+// Maximum number of random inputs applied between each gravity tick
+#define SIM_RANDOM_MAX_INPUTS 4
+
+// Script characters that only apply an input, every other character runs a gravity tick (H hard drops first)
+#define SIM_SCRIPT_INPUTS "LRDUC"
+
+typedef enum {
+    POLICY_RANDOM,
+    POLICY_SCRIPT,
+    POLICY_AI,
+} policy_t;
+
+/** Settings shared (read only) by all workers */
+typedef struct {
+    uint32_t num_games;
+    uint32_t num_threads;
+    uint64_t seed;
+    uint32_t max_pieces;
+    policy_t policy;
+    const char* script;
+
+    /** search settings of the AI policy */
+    uint8_t ai_depth;
+    uint8_t ai_beam_width;
+
+    /** transposition table shared by every game of the AI policy, NULL for each game to use its player's own table */
+    ttable_t* ai_table;
+} sim_config_t;
+
+/**
+ * A worker's range of games [head, tail), packed into one word so it can be updated with a single CAS.
+ * The owner takes games from the tail, other workers steal from the head.
+ */
+typedef struct {
+    _Atomic uint64_t range;
+    char padding[64 - sizeof(uint64_t)];  // keep each worker's range on its own cache line
+} sim_queue_t;
+
+/** Totals for the games played by a worker */
+typedef struct {
+    uint64_t games;
+    uint64_t pieces;
+    uint64_t lines;
+    uint64_t ticks;
+    uint64_t inputs;
+
+    /** placements scored by the AI policy, and how often its cache of placements was used */
+    uint64_t placements;
+    uint64_t cache_lookups;
+    uint64_t cache_hits;
+    uint64_t table_lookups;
+    uint64_t table_hits;
+
+    /** order independent hash of every game's result, used to check that runs are reproducible */
+    uint64_t checksum;
+} sim_stats_t;
+
+typedef struct {
+    uint32_t id;
+    const sim_config_t* config;
+    sim_queue_t* queues;
+    sim_stats_t stats;
+} sim_worker_t;
+
+#define RANGE_PACK(head, tail) (((uint64_t)(head) << 32) | (uint32_t)(tail))
+#define RANGE_HEAD(range)      ((uint32_t)((range) >> 32))
+#define RANGE_TAIL(range)      ((uint32_t)(range))
+
+/**
+ * @brief splitmix64, used to derive independent seeds from a base seed and a game index.
+ */
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief xorshift64, the random number generator used by the random input policy.
+ */
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Take a game from the tail of our own queue.
+ * @return false if our queue is empty.
+ */
+static bool queue_pop(sim_queue_t* queue, uint32_t* game)
+{
+    uint64_t range = atomic_load(&queue->range);
+    while (RANGE_HEAD(range) < RANGE_TAIL(range))
+    {
+        uint64_t new_range = RANGE_PACK(RANGE_HEAD(range), RANGE_TAIL(range) - 1);
+        if (atomic_compare_exchange_weak(&queue->range, &range, new_range))
+        {
+            *game = RANGE_TAIL(range) - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Steal a game from the head of another worker's queue.
+ * @return false if the queue is empty.
+ */
+static bool queue_steal(sim_queue_t* queue, uint32_t* game)
+{
+    uint64_t range = atomic_load(&queue->range);
+    while (RANGE_HEAD(range) < RANGE_TAIL(range))
+    {
+        uint64_t new_range = RANGE_PACK(RANGE_HEAD(range) + 1, RANGE_TAIL(range));
+        if (atomic_compare_exchange_weak(&queue->range, &range, new_range))
+        {
+            *game = RANGE_HEAD(range);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Apply a gravity tick to the engine, and record what happened.
+ */
+static void sim_tick(engine_t* engine, sim_stats_t* stats)
+{
+    engine_event_t event = engine_tick(engine);
+    stats->ticks++;
+    if (event.piece_placed)
+        stats->pieces++;
+}
+
+/**
+ * @brief Play a single game until the engine dies or `max_pieces` have been placed.
+ */
+static void sim_play_game(const sim_config_t* config, uint32_t game, sim_stats_t* stats)
+{
+    uint64_t game_seed = splitmix64(config->seed ^ splitmix64(game));
+    uint64_t rng = game_seed | 1;  // xorshift state must be non-zero
+
+    engine_t engine;
+    engine_init(&engine, (uint32_t)game_seed);
+
+    uint64_t start_pieces = stats->pieces;
+    size_t script_len = config->script ? strlen(config->script) : 0;
+    size_t script_pos = 0;
+
+    ai_t ai;
+    if (config->policy == POLICY_AI)
+    {
+        ai_init(&ai, NULL, config->ai_depth, config->ai_beam_width);
+        if (config->ai_table)
+            ai_set_table(&ai, config->ai_table);
+    }
+
+    while (engine.state == ENGINE_STATE_PLAYING && stats->pieces - start_pieces < config->max_pieces)
+    {
+        if (config->policy == POLICY_RANDOM)
+        {
+            uint8_t num_inputs = xorshift64(&rng) % (SIM_RANDOM_MAX_INPUTS + 1);
+            for (uint8_t i = 0; i < num_inputs; i++)
+            {
+                engine_input_t input = ENGINE_INPUT_LEFT + xorshift64(&rng) % (ENGINE_INPUT_ROTATE_CCW - ENGINE_INPUT_LEFT + 1);
+                engine_input(&engine, input);
+                stats->inputs++;
+            }
+            sim_tick(&engine, stats);
+            continue;
+        }
+
+        if (config->policy == POLICY_AI)
+        {
+            // the piece is moved into place without gravity, then placed straight away by the tick after the hard drop
+            engine_input_t input = ai_next_input(&ai, &engine);
+            engine_input(&engine, input);
+            stats->inputs++;
+            if (input == ENGINE_INPUT_DROP)
+                sim_tick(&engine, stats);
+            continue;
+        }
+
+        char c = config->script[script_pos];
+        script_pos = (script_pos + 1) % script_len;
+        switch (c)
+        {
+        case 'L':
+            engine_input(&engine, ENGINE_INPUT_LEFT);
+            stats->inputs++;
+            break;
+
+        case 'R':
+            engine_input(&engine, ENGINE_INPUT_RIGHT);
+            stats->inputs++;
+            break;
+
+        case 'D':
+            engine_input(&engine, ENGINE_INPUT_DOWN);
+            stats->inputs++;
+            break;
+
+        case 'U':
+            engine_input(&engine, ENGINE_INPUT_ROTATE);
+            stats->inputs++;
+            break;
+
+        case 'C':
+            engine_input(&engine, ENGINE_INPUT_ROTATE_CCW);
+            stats->inputs++;
+            break;
+
+        case 'H':
+            // placed straight away, as on the UCFK4
+            engine_input(&engine, ENGINE_INPUT_DROP);
+            stats->inputs++;
+            sim_tick(&engine, stats);
+            break;
+
+        case 'T':
+        default:
+            sim_tick(&engine, stats);
+            break;
+        }
+    }
+
+    if (config->policy == POLICY_AI)
+    {
+        stats->placements += ai.placements;
+        stats->cache_lookups += ai.cache_lookups;
+        stats->cache_hits += ai.cache_hits;
+        stats->table_lookups += ai.table_lookups;
+        stats->table_hits += ai.table_hits;
+    }
+
+    stats->games++;
+    stats->lines += engine.lines_cleared;
+    stats->checksum += splitmix64(game ^ ((uint64_t)engine.lines_cleared << 32) ^ (stats->pieces - start_pieces));
+}
+
+/**
+ * @brief Worker thread, plays games from its own queue then steals from the others until all are empty.
+ */
+static void* sim_worker(void* arg)
+{
+    sim_worker_t* worker = arg;
+    const sim_config_t* config = worker->config;
+
+    uint32_t game;
+    while (queue_pop(&worker->queues[worker->id], &game))
+        sim_play_game(config, game, &worker->stats);
+
+    // our queue is empty, steal from the other workers
+    for (uint32_t i = 1; i < config->num_threads; i++)
+    {
+        sim_queue_t* victim = &worker->queues[(worker->id + i) % config->num_threads];
+        while (queue_steal(victim, &game))
+            sim_play_game(config, game, &worker->stats);
+    }
+
+    return NULL;
+}
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-g games] [-t threads] [-s seed] [-m max_pieces] [-p random|ai|script:<LRDUCHT...>] [-d depth] [-w beam_width] [-T table_mb]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    sim_config_t config = {
+        .num_games = SIM_DEFAULT_GAMES,
+        .num_threads = sysconf(_SC_NPROCESSORS_ONLN),
+        .seed = SIM_DEFAULT_SEED,
+        .max_pieces = SIM_DEFAULT_MAX_PIECES,
+        .policy = POLICY_RANDOM,
+        .script = NULL,
+        .ai_depth = 0,
+        .ai_beam_width = 0,
+        .ai_table = NULL,
+    };
+    uint32_t table_mb = SIM_DEFAULT_TABLE_MB;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:t:s:m:p:d:w:T:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            config.num_games = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            config.num_threads = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'm':
+            config.max_pieces = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            if (strcmp(optarg, "random") == 0)
+                config.policy = POLICY_RANDOM;
+            else if (strcmp(optarg, "ai") == 0)
+                config.policy = POLICY_AI;
+            else if (strncmp(optarg, "script:", 7) == 0 && optarg[7])
+            {
+                config.policy = POLICY_SCRIPT;
+                config.script = optarg + 7;
+
+                // the game only advances on a gravity tick, so a script without one would never finish a game
+                if (config.script[strspn(config.script, SIM_SCRIPT_INPUTS)] == '\0')
+                {
+                    fprintf(stderr, "script must contain a gravity tick (T or H)\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            else
+                usage(argv[0]);
+            break;
+
+        case 'd':
+            config.ai_depth = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'w':
+            config.ai_beam_width = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'T':
+            table_mb = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (config.num_threads < 1)
+        config.num_threads = 1;
+    if (config.num_threads > SIM_MAX_THREADS)
+        config.num_threads = SIM_MAX_THREADS;
+
+    // the largest power of 2 entries that fits in the table's size
+    ttable_t table;
+    ttable_entry_t* entries = NULL;
+    if (config.policy == POLICY_AI && table_mb > 0)
+    {
+        uint32_t size = 2;
+        while ((uint64_t)size * 2 * sizeof(ttable_entry_t) <= (uint64_t)table_mb << 20 && size < (1u << 31))
+            size *= 2;
+
+        entries = malloc(size * sizeof(ttable_entry_t));
+        if (!entries)
+        {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        ttable_init(&table, entries, size);
+        config.ai_table = &table;
+    }
+
+    // split the games evenly between the workers, the remainder goes to the first workers
+    static sim_queue_t queues[SIM_MAX_THREADS];
+    static sim_worker_t workers[SIM_MAX_THREADS];
+    pthread_t threads[SIM_MAX_THREADS];
+
+    uint32_t head = 0;
+    for (uint32_t i = 0; i < config.num_threads; i++)
+    {
+        uint32_t count = config.num_games / config.num_threads + (i < config.num_games % config.num_threads);
+        atomic_store(&queues[i].range, RANGE_PACK(head, head + count));
+        head += count;
+
+        workers[i] = (sim_worker_t){
+            .id = i,
+            .config = &config,
+            .queues = queues,
+        };
+    }
+
+    double start = time_now();
+    for (uint32_t i = 0; i < config.num_threads; i++)
+        pthread_create(&threads[i], NULL, sim_worker, &workers[i]);
+
+    sim_stats_t total = {0};
+    for (uint32_t i = 0; i < config.num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        total.games += workers[i].stats.games;
+        total.pieces += workers[i].stats.pieces;
+        total.lines += workers[i].stats.lines;
+        total.ticks += workers[i].stats.ticks;
+        total.inputs += workers[i].stats.inputs;
+        total.placements += workers[i].stats.placements;
+        total.cache_lookups += workers[i].stats.cache_lookups;
+        total.cache_hits += workers[i].stats.cache_hits;
+        total.table_lookups += workers[i].stats.table_lookups;
+        total.table_hits += workers[i].stats.table_hits;
+        total.checksum += workers[i].stats.checksum;
+    }
+    double elapsed = time_now() - start;
+
+    printf("threads:  %u\n", config.num_threads);
+    printf("games:    %llu\n", (unsigned long long)total.games);
+    printf("pieces:   %llu\n", (unsigned long long)total.pieces);
+    printf("lines:    %llu\n", (unsigned long long)total.lines);
+    printf("ticks:    %llu\n", (unsigned long long)total.ticks);
+    printf("inputs:   %llu\n", (unsigned long long)total.inputs);
+    printf("checksum: %016llx\n", (unsigned long long)total.checksum);
+    printf("elapsed:  %.3f s\n", elapsed);
+    printf("games/s:  %.0f\n", total.games / elapsed);
+    printf("pieces/s: %.0f\n", total.pieces / elapsed);
+    printf("lines/s:  %.0f\n", total.lines / elapsed);
+    if (config.policy == POLICY_AI)
+    {
+        printf("placements/s: %.0f (%.0f per thread)\n", total.placements / elapsed, total.placements / elapsed / config.num_threads);
+        printf("cache hits:   %.1f%%\n", total.cache_lookups ? 100.0 * total.cache_hits / total.cache_lookups : 0.0);
+        printf("table hits:   %.1f%%\n", total.table_lookups ? 100.0 * total.table_hits / total.table_lookups : 0.0);
+    }
+
+    free(entries);
+
+    return EXIT_SUCCESS;
+}
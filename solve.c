@@ -0,0 +1,633 @@
+/** @file solve.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Exhaustive solver for the most lines that can be cleared from each seed's order of pieces, run on a host machine.
+ *
+ *  For each seed, a depth first search tries every placement of each of the first `horizon` pieces the
+ *  engine deals for that seed, and finds the most lines that can be cleared. The rules are the engine's:
+ *  each piece spawns where `piece_generate_next` spawns it, and the round is over if it doesn't fit there.
+ *  It can then be locked anywhere it can be moved and rotated to from the spawn (including under overhangs
+ *  and by wall kicks), as when playing with `engine_tick`.
+ *
+ *  Each piece fills `PIECE_NUM_POINTS` tiles of a `BOARD_WIDTH` wide line, so at most 4 lines can be cleared
+ *  with every 5 pieces. Almost every seed reaches that, so the default horizon is a multiple of 5 pieces,
+ *  where reaching it leaves the board empty and the seeds differ in whether they can.
+ *
+ *  Results are memoised in a transposition table shared by every thread. Once only a few pieces are left,
+ *  a position is keyed by the board and the pieces left, so it is shared by every seed that reaches it.
+ *
+ *  Results are written to a memory mapped file, a `solve_header_t` then one byte per seed (`SOLVE_UNSOLVED`
+ *  until it has been solved), so an interrupted run resumes from the seeds it had not solved yet.
+ *
+ *  Usage:
+ *    ./solve [-f first_seed] [-n seeds] [-H horizon] [-t threads] [-T table_mb] [-o file]   solve seeds into file
+ *    ./solve -r file [-a] [-d depth] [-w beam_width]   report the results, -a grades the AI against them
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "board.h"
+#include "engine.h"
+#include "piece.h"
+#include "ttable.h"
+
+#define SOLVE_MAX_THREADS 256
+
+// Default settings
+#define SOLVE_DEFAULT_FIRST_SEED 1
+#define SOLVE_DEFAULT_SEEDS      10000
+#define SOLVE_DEFAULT_HORIZON    10  // clears the board, which about 3% of seeds can't
+#define SOLVE_DEFAULT_TABLE_MB   256
+#define SOLVE_DEFAULT_FILE       "solve.bin"
+
+// Most pieces that can be searched, the step of a position must fit in its key
+#define SOLVE_MAX_HORIZON 63
+
+// Most seeds in one file, each seed's positions are tagged with its index in the file
+#define SOLVE_MAX_SEEDS (1u << 22)
+
+// Positions with at most this many pieces left are keyed by the pieces left, 3 bits each above the 35 bits of the board
+#define SOLVE_SHARED_PIECES 9
+
+// Number of the worst seeds listed by the report
+#define SOLVE_REPORT_WORST 10
+
+/** Result of a seed that has not been solved yet */
+#define SOLVE_UNSOLVED 0xFF
+
+#define SOLVE_MAGIC   "TSLV"
+#define SOLVE_VERSION 2
+
+/** Header of a results file, in the host's byte order, followed by one result per seed */
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t horizon;
+    uint16_t reserved;
+    uint32_t first_seed;
+    uint32_t count;
+} solve_header_t;
+
+/** Settings and state shared by all workers */
+typedef struct {
+    uint32_t num_threads;
+    uint8_t horizon;
+
+    ttable_t table;
+
+    /** the results file, mapped into memory */
+    solve_header_t* header;
+    uint8_t* results;
+
+    /** the next seed to solve, as an index into `results` */
+    _Atomic uint32_t next;
+} solve_t;
+
+typedef struct {
+    solve_t* solve;
+    pthread_t thread;
+
+    /** the pieces of the seed being solved */
+    uint8_t sequence[SOLVE_MAX_HORIZON];
+    uint32_t tag;
+
+    uint64_t seeds;
+    uint64_t nodes;
+    uint64_t table_lookups;
+    uint64_t table_hits;
+} solve_worker_t;
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Key of a position in the transposition table, never 0.
+ *        With at most `SOLVE_SHARED_PIECES` pieces left: the pieces left (idx + 1), then the board's rows.
+ *        Otherwise: bit 63 set, then the seed's tag, the step and the board's rows, so it is only used by this seed.
+ */
+static uint64_t solve_key(const solve_worker_t* worker, const board_t* board, uint8_t step)
+{
+    const solve_t* solve = worker->solve;
+    uint8_t left = solve->horizon - step;
+
+    uint64_t key = 0;
+    if (left > SOLVE_SHARED_PIECES)
+        key = (1ULL << 63) | ((uint64_t)worker->tag << 41) | ((uint64_t)step << 35);
+    else
+    {
+        for (uint8_t i = step; i < solve->horizon; i++)
+            key = (key << 3) | (worker->sequence[i] + 1);
+        key <<= BOARD_HEIGHT * BOARD_WIDTH;
+    }
+
+    for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+        key |= (uint64_t)board->rows[y] << (y * BOARD_WIDTH);
+    return key;
+}
+
+/** Index of a piece's orientation and position in the search for its placements, positions are at most 4 off the board */
+#define SOLVE_STATE_INDEX(piece) ((piece)->orientation << 8 | ((piece)->pos.x + 4) << 4 | ((piece)->pos.y + 4))
+#define SOLVE_MAX_STATES         (PIECE_NUM_ROTATIONS << 8)
+
+/** Most places a piece can be locked, each orientation in each column and row */
+#define SOLVE_MAX_PLACEMENTS (PIECE_NUM_ROTATIONS * BOARD_WIDTH * BOARD_HEIGHT)
+
+/**
+ * @brief Find every board that can be left by locking the piece `idx`, after it spawns on `board` as in the engine.
+ *        The piece can be moved left, right and down and rotated either way (with wall kicks) any number of times
+ *        before it is locked where it can't move down, as when playing with `engine_tick`.
+ * @param children Receives each board, at most `SOLVE_MAX_PLACEMENTS`.
+ * @param lines Receives the number of lines cleared by each placement.
+ * @return The number of boards, 0 if the piece can't be spawned and the round is over.
+ */
+static uint8_t solve_placements(const board_t* board, uint8_t idx, board_t* children, uint8_t* lines)
+{
+    piece_t spawned = {.idx = idx, .pos = {PIECE_SPAWN_X, PIECE_SPAWN_Y}, .orientation = ORIENTATION_NORTH};
+    if (!board_valid_position(board, &spawned, spawned.pos.x, spawned.pos.y, spawned.orientation))
+        return 0;
+
+    // moving the piece marks rows of the board as dirty, so it is moved on a copy
+    board_t scratch = *board;
+
+    // breadth first search of every position reachable from the spawn
+    piece_t queue[SOLVE_MAX_STATES];
+    uint64_t visited[SOLVE_MAX_STATES / 64] = {0};
+    uint16_t head = 0;
+    uint16_t tail = 0;
+    queue[tail++] = spawned;
+    visited[SOLVE_STATE_INDEX(&spawned) / 64] |= 1ULL << (SOLVE_STATE_INDEX(&spawned) % 64);
+
+    // the packed rows and lines cleared of each board, so a board left by several placements is only returned once
+    uint64_t keys[SOLVE_MAX_PLACEMENTS];
+    uint8_t count = 0;
+
+    while (head < tail)
+    {
+        const piece_t piece = queue[head++];
+
+        // counter-clockwise doesn't always reach the same position as three clockwise turns, because of the kicks
+        piece_t moves[5] = {piece, piece, piece, piece, piece};
+        bool valid[5] = {
+            piece_move(&scratch, &moves[0], DIRECTION_DOWN),
+            piece_move(&scratch, &moves[1], DIRECTION_LEFT),
+            piece_move(&scratch, &moves[2], DIRECTION_RIGHT),
+            piece_rotate(&scratch, &moves[3], true),
+            piece_rotate(&scratch, &moves[4], false),
+        };
+
+        // resting on the stack, the next gravity step locks it here
+        if (!valid[0])
+        {
+            board_t child = *board;
+            uint8_t cleared = board_place_piece(&child, &piece);
+
+            uint64_t key = (uint64_t)cleared << (BOARD_HEIGHT * BOARD_WIDTH);
+            for (uint8_t y = 0; y < BOARD_HEIGHT; y++)
+                key |= (uint64_t)child.rows[y] << (y * BOARD_WIDTH);
+
+            uint8_t i = 0;
+            while (i < count && keys[i] != key)
+                i++;
+
+            if (i == count)
+            {
+                keys[count] = key;
+                children[count] = child;
+                lines[count++] = cleared;
+            }
+        }
+
+        for (uint8_t m = 0; m < 5; m++)
+        {
+            uint16_t index = SOLVE_STATE_INDEX(&moves[m]);
+            if (!valid[m] || visited[index / 64] & (1ULL << (index % 64)))
+                continue;
+
+            visited[index / 64] |= 1ULL << (index % 64);
+            queue[tail++] = moves[m];
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief The most lines that can be cleared by placing the pieces from `step` to the horizon on `board`.
+ * @param filled Number of filled tiles on the board.
+ */
+static uint8_t solve_search(solve_worker_t* worker, const board_t* board, uint8_t step, uint8_t filled)
+{
+    const solve_t* solve = worker->solve;
+    if (step == solve->horizon)
+        return 0;
+
+    // every line needs BOARD_WIDTH tiles, and each piece adds PIECE_NUM_POINTS, so this is as many as could be cleared.
+    // Placing a piece never changes the lines cleared plus this bound, so once a placement reaches it the rest are skipped
+    uint8_t bound = (filled + PIECE_NUM_POINTS * (solve->horizon - step)) / BOARD_WIDTH;
+    if (bound == 0)
+        return 0;
+
+    uint64_t key = solve_key(worker, board, step);
+    uint64_t data;
+    worker->table_lookups++;
+    if (ttable_probe(&worker->solve->table, key, &data))
+    {
+        worker->table_hits++;
+        return data;
+    }
+
+    worker->nodes++;
+    board_t children[SOLVE_MAX_PLACEMENTS];
+    uint8_t lines[SOLVE_MAX_PLACEMENTS];
+    uint8_t count = solve_placements(board, worker->sequence[step], children, lines);
+
+    uint8_t best = 0;
+    for (uint8_t i = 0; i < count && best < bound; i++)
+    {
+        uint8_t total = lines[i] + solve_search(worker, &children[i], step + 1, filled + PIECE_NUM_POINTS - lines[i] * BOARD_WIDTH);
+        if (total > best)
+            best = total;
+    }
+
+    ttable_store(&worker->solve->table, key, best);
+    return best;
+}
+
+/**
+ * @brief The first `horizon` pieces the engine deals for `seed`.
+ */
+static void solve_sequence(uint32_t seed, uint8_t horizon, uint8_t* sequence)
+{
+    piece_generator_t generator;
+    piece_generator_init(&generator, seed);
+
+    board_t board;
+    board_init(&board);
+    for (uint8_t i = 0; i < horizon; i++)
+    {
+        piece_t piece;
+        piece_generate_next(&generator, &board, &piece);
+        sequence[i] = piece.idx;
+    }
+}
+
+/**
+ * @brief Worker thread, solves seeds until they have all been taken.
+ */
+static void* solve_worker(void* arg)
+{
+    solve_worker_t* worker = arg;
+    solve_t* solve = worker->solve;
+
+    uint32_t index;
+    while ((index = atomic_fetch_add_explicit(&solve->next, 1, memory_order_relaxed)) < solve->header->count)
+    {
+        if (solve->results[index] != SOLVE_UNSOLVED)
+            continue;
+
+        solve_sequence(solve->header->first_seed + index, solve->horizon, worker->sequence);
+        worker->tag = index;
+
+        board_t board;
+        board_init(&board);
+        solve->results[index] = solve_search(worker, &board, 0, 0);
+        worker->seeds++;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Map a results file into memory, creating it if it doesn't exist.
+ * @param header The header the file must have, an existing file with a different header is not used.
+ * @return The mapped file, or NULL if it couldn't be mapped.
+ */
+static solve_header_t* solve_map(const char* path, const solve_header_t* header, bool create)
+{
+    int fd = open(path, create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    bool fresh = create && size == 0;
+    if (fresh)
+    {
+        size = sizeof(solve_header_t) + header->count;
+        if (ftruncate(fd, size) < 0)
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+
+    if (size < sizeof(solve_header_t))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    solve_header_t* mapped = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return NULL;
+
+    if (fresh)
+    {
+        *mapped = *header;
+        memset(mapped + 1, SOLVE_UNSOLVED, header->count);
+    }
+
+    bool valid = memcmp(mapped->magic, SOLVE_MAGIC, sizeof(mapped->magic)) == 0 && mapped->version == SOLVE_VERSION
+                 && mapped->horizon >= 1 && mapped->horizon <= SOLVE_MAX_HORIZON
+                 && size >= sizeof(solve_header_t) + mapped->count;
+    if (valid && create)
+        valid = mapped->horizon == header->horizon && mapped->first_seed == header->first_seed && mapped->count == header->count;
+
+    if (!valid)
+    {
+        munmap(mapped, size);
+        return NULL;
+    }
+
+    return mapped;
+}
+
+static int solve_seeds(const char* path, const solve_header_t* header, uint32_t num_threads, uint32_t table_mb)
+{
+    static solve_t solve;
+    solve.num_threads = num_threads;
+    solve.horizon = header->horizon;
+
+    solve.header = solve_map(path, header, true);
+    if (!solve.header)
+    {
+        fprintf(stderr, "could not map %s, or it has results for different seeds\n", path);
+        return EXIT_FAILURE;
+    }
+    solve.results = (uint8_t*)(solve.header + 1);
+
+    // the largest power of 2 entries that fits in the table's size
+    uint32_t size = 2;
+    while ((uint64_t)size * 2 * sizeof(ttable_entry_t) <= (uint64_t)table_mb << 20 && size < (1u << 31))
+        size *= 2;
+
+    ttable_entry_t* entries = malloc(size * sizeof(ttable_entry_t));
+    if (!entries)
+    {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    ttable_init(&solve.table, entries, size);
+    atomic_store(&solve.next, 0);
+
+    static solve_worker_t workers[SOLVE_MAX_THREADS];
+    double start = time_now();
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        workers[i] = (solve_worker_t){.solve = &solve};
+        pthread_create(&workers[i].thread, NULL, solve_worker, &workers[i]);
+    }
+
+    solve_worker_t total = {0};
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        total.seeds += workers[i].seeds;
+        total.nodes += workers[i].nodes;
+        total.table_lookups += workers[i].table_lookups;
+        total.table_hits += workers[i].table_hits;
+    }
+    double elapsed = time_now() - start;
+
+    msync(solve.header, sizeof(solve_header_t) + header->count, MS_SYNC);
+    munmap(solve.header, sizeof(solve_header_t) + header->count);
+    free(entries);
+
+    printf("threads:    %u\n", num_threads);
+    printf("seeds:      %llu solved, %u in %s\n", (unsigned long long)total.seeds, header->count, path);
+    printf("horizon:    %u pieces\n", header->horizon);
+    printf("nodes:      %llu\n", (unsigned long long)total.nodes);
+    printf("table hits: %.1f%%\n", total.table_lookups ? 100.0 * total.table_hits / total.table_lookups : 0.0);
+    printf("elapsed:    %.3f s\n", elapsed);
+    printf("seeds/s:    %.0f\n", total.seeds / elapsed);
+    printf("nodes/s:    %.0f\n", total.nodes / elapsed);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Lines the AI clears from a seed within the first `horizon` pieces.
+ */
+static uint16_t solve_play_ai(uint32_t seed, uint8_t horizon, uint8_t depth, uint8_t beam_width)
+{
+    engine_t engine;
+    engine_init(&engine, seed);
+
+    static ai_t ai;
+    ai_init(&ai, NULL, depth, beam_width);
+
+    uint8_t pieces = 0;
+    while (engine.state == ENGINE_STATE_PLAYING && pieces < horizon)
+    {
+        engine_input_t input = ai_next_input(&ai, &engine);
+        engine_input(&engine, input);
+        if (input == ENGINE_INPUT_DROP && engine_tick(&engine).piece_placed)
+            pieces++;
+    }
+
+    return engine.lines_cleared;
+}
+
+/**
+ * @brief Print the distribution of the results, the worst seeds, and how the AI does on the same seeds.
+ */
+static int solve_report(const char* path, bool grade_ai, uint8_t depth, uint8_t beam_width)
+{
+    solve_header_t* header = solve_map(path, NULL, false);
+    if (!header)
+    {
+        fprintf(stderr, "could not read %s\n", path);
+        return EXIT_FAILURE;
+    }
+    const uint8_t* results = (const uint8_t*)(header + 1);
+
+    uint32_t histogram[SOLVE_MAX_HORIZON + 1] = {0};
+    uint32_t worst[SOLVE_REPORT_WORST];
+    uint32_t num_worst = 0;
+    uint32_t solved = 0;
+    uint32_t invalid = 0;
+    uint64_t lines = 0;
+    uint64_t ai_lines = 0;
+    uint32_t ai_optimal = 0;
+
+    for (uint32_t i = 0; i < header->count; i++)
+    {
+        if (results[i] == SOLVE_UNSOLVED)
+            continue;
+
+        // no more lines can be cleared than pieces are placed, so a larger result is from a corrupt file
+        if (results[i] > header->horizon)
+        {
+            invalid++;
+            continue;
+        }
+
+        solved++;
+        lines += results[i];
+        histogram[results[i]]++;
+
+        // keep the worst seeds sorted, the lowest result first
+        if (num_worst < SOLVE_REPORT_WORST || results[i] < results[worst[SOLVE_REPORT_WORST - 1]])
+        {
+            uint32_t j = num_worst < SOLVE_REPORT_WORST ? num_worst++ : SOLVE_REPORT_WORST - 1;
+            for (; j > 0 && results[worst[j - 1]] > results[i]; j--)
+                worst[j] = worst[j - 1];
+            worst[j] = i;
+        }
+
+        if (grade_ai)
+        {
+            uint16_t played = solve_play_ai(header->first_seed + i, header->horizon, depth, beam_width);
+            ai_lines += played;
+            ai_optimal += played >= results[i];
+        }
+    }
+
+    printf("seeds:  %u solved of %u (first seed %u)\n", solved, header->count, header->first_seed);
+    if (invalid)
+        printf("invalid: %u results larger than the horizon, skipped\n", invalid);
+    printf("horizon: %u pieces\n", header->horizon);
+    printf("mean:   %.2f lines\n", solved ? (double)lines / solved : 0.0);
+    for (uint8_t n = 0; n <= SOLVE_MAX_HORIZON; n++)
+    {
+        if (histogram[n])
+            printf("  %2u lines: %u\n", n, histogram[n]);
+    }
+
+    printf("worst seeds:");
+    for (uint32_t i = 0; i < num_worst; i++)
+        printf(" %u (%u)", header->first_seed + worst[i], results[worst[i]]);
+    printf("\n");
+
+    if (grade_ai)
+    {
+        printf("ai:     %.2f lines, %.1f%% of the most, the most on %.1f%% of seeds\n", solved ? (double)ai_lines / solved : 0.0,
+               lines ? 100.0 * ai_lines / lines : 0.0, solved ? 100.0 * ai_optimal / solved : 0.0);
+    }
+
+    munmap(header, sizeof(solve_header_t) + header->count);
+    return EXIT_SUCCESS;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [-f first_seed] [-n seeds] [-H horizon] [-t threads] [-T table_mb] [-o file]\n"
+            "       %s -r file [-a] [-d depth] [-w beam_width]\n",
+            name, name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    solve_header_t header = {
+        .magic = SOLVE_MAGIC,
+        .version = SOLVE_VERSION,
+        .first_seed = SOLVE_DEFAULT_FIRST_SEED,
+        .count = SOLVE_DEFAULT_SEEDS,
+    };
+    uint32_t num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t table_mb = SOLVE_DEFAULT_TABLE_MB;
+    unsigned long horizon = SOLVE_DEFAULT_HORIZON;
+    const char* path = SOLVE_DEFAULT_FILE;
+    const char* report = NULL;
+    bool grade_ai = false;
+    uint8_t depth = 0;
+    uint8_t beam_width = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:H:t:T:o:r:ad:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            header.first_seed = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            header.count = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'H':
+            horizon = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            num_threads = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'T':
+            table_mb = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'o':
+            path = optarg;
+            break;
+
+        case 'r':
+            report = optarg;
+            break;
+
+        case 'a':
+            grade_ai = true;
+            break;
+
+        case 'd':
+            depth = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'w':
+            beam_width = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (report)
+        return solve_report(report, grade_ai, depth, beam_width);
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > SOLVE_MAX_THREADS)
+        num_threads = SOLVE_MAX_THREADS;
+    // checked before it is narrowed into the header, so e.g. -H 256 isn't taken as 0
+    if (horizon < 1 || horizon > SOLVE_MAX_HORIZON || header.count < 1 || header.count > SOLVE_MAX_SEEDS)
+        usage(argv[0]);
+    header.horizon = horizon;
+
+    return solve_seeds(path, &header, num_threads, table_mb);
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+/** @file task_stats.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Optional instrumentation of the tasks run by `task_schedule`.
+ *         Records the execution time of each task in timer ticks, and counts deadline overruns
+ *         (a single run taking longer than the task's period).
+ */
+
+#include "task_stats.h"
+
+#ifdef TASK_STATS
+
+#include <stdbool.h>
+#include <string.h>
+#include <timer.h>
+
+#ifdef __AVR__
+#include <ir_uart.h>
+#else
+#include <stdio.h>
+#endif
+
+static task_stats_t task_stats[TASK_STATS_MAX_TASKS];
+static uint8_t task_stats_num = 0;
+
+/**
+ * @brief Runs the instrumented task, and records how long it took.
+ * @param data The `task_stats_t` of the task.
+ */
+static void task_stats_run(void* data)
+{
+    task_stats_t* stats = data;
+
+    timer_tick_t start = timer_get();
+    stats->func(stats->data);
+    timer_tick_t duration = timer_get() - start;
+
+    if (!stats->sampled || duration < stats->min)
+        stats->min = duration;
+    if (duration > stats->max)
+        stats->max = duration;
+    if (duration > stats->period && stats->overruns < UINT16_MAX)
+        stats->overruns++;
+    stats->sampled = true;
+
+    stats->total += duration;
+    stats->count++;
+
+    stats->history[stats->history_pos] = duration;
+    stats->history_pos = (stats->history_pos + 1) % TASK_STATS_HISTORY;
+
+    // bucket `i` counts durations < 2^(i+1), the last bucket counts everything larger
+    uint8_t bucket = 0;
+    while (bucket < TASK_STATS_BUCKETS - 1 && (duration >> (bucket + 1)))
+        bucket++;
+    if (stats->histogram[bucket] == UINT16_MAX)
+    {
+        for (uint8_t i = 0; i < TASK_STATS_BUCKETS; i++)
+            stats->histogram[i] /= 2;
+    }
+    stats->histogram[bucket]++;
+
+    // avoid the mean overflowing, restart once the count wraps
+    if (stats->count == UINT16_MAX)
+    {
+        stats->count = 0;
+        stats->total = 0;
+    }
+}
+
+/**
+ * @brief Instrument the given tasks. Each task's `func` and `data` are replaced with a wrapper
+ *        that times the original task. Must be called before `task_schedule`.
+ * @param names Name of each task, used in the report.
+ */
+void task_stats_wrap(task_t* tasks, const char* const* names, uint8_t num_tasks)
+{
+    for (uint8_t i = 0; i < num_tasks && task_stats_num < TASK_STATS_MAX_TASKS; i++)
+    {
+        task_stats_t* stats = &task_stats[task_stats_num++];
+        memset(stats, 0, sizeof(task_stats_t));
+        stats->name = names[i];
+        stats->func = tasks[i].func;
+        stats->data = tasks[i].data;
+        stats->period = tasks[i].period;
+
+        tasks[i].func = task_stats_run;
+        tasks[i].data = stats;
+    }
+}
+
+/**
+ * @brief Returns the stats recorded for the task at `index`, in the order passed to `task_stats_wrap`.
+ */
+const task_stats_t* task_stats_get(uint8_t index)
+{
+    if (index >= task_stats_num)
+        return NULL;
+
+    return &task_stats[index];
+}
+
+/**
+ * @brief Clear the stats of every task.
+ */
+void task_stats_reset(void)
+{
+    for (uint8_t i = 0; i < task_stats_num; i++)
+    {
+        task_stats_t* stats = &task_stats[i];
+        stats->sampled = false;
+        stats->min = 0;
+        stats->max = 0;
+        stats->total = 0;
+        stats->count = 0;
+        stats->overruns = 0;
+        stats->history_pos = 0;
+        memset(stats->history, 0, sizeof(stats->history));
+        memset(stats->histogram, 0, sizeof(stats->histogram));
+    }
+}
+
+#ifdef __AVR__
+
+/**
+ * @brief Send a number as decimal text over the IR UART, avoids pulling in printf.
+ */
+static void ir_uart_put_uint(uint32_t value)
+{
+    char buffer[11];
+    uint8_t i = sizeof(buffer) - 1;
+    buffer[i] = '\0';
+
+    do
+    {
+        buffer[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    ir_uart_puts(&buffer[i]);
+}
+
+/**
+ * @brief Report the stats of every task. On the UCFK4 this is sent as text over the IR UART,
+ *        one line per task: `name period min max mean overruns`.
+ */
+void task_stats_dump(void)
+{
+    for (uint8_t i = 0; i < task_stats_num; i++)
+    {
+        const task_stats_t* stats = &task_stats[i];
+        ir_uart_puts(stats->name);
+        ir_uart_putc(' ');
+        ir_uart_put_uint(stats->period);
+        ir_uart_putc(' ');
+        ir_uart_put_uint(stats->min);
+        ir_uart_putc(' ');
+        ir_uart_put_uint(stats->max);
+        ir_uart_putc(' ');
+        ir_uart_put_uint(stats->count ? stats->total / stats->count : 0);
+        ir_uart_putc(' ');
+        ir_uart_put_uint(stats->overruns);
+        ir_uart_puts("\r\n");
+    }
+}
+
+#else
+
+/**
+ * @brief Report the stats of every task, printed with a histogram of execution times.
+ */
+void task_stats_dump(void)
+{
+    for (uint8_t i = 0; i < task_stats_num; i++)
+    {
+        const task_stats_t* stats = &task_stats[i];
+        printf(
+            "%-22s period %5u  min %5u  max %5u  mean %5lu  overruns %u\n",
+            stats->name,
+            (unsigned)stats->period,
+            (unsigned)stats->min,
+            (unsigned)stats->max,
+            (unsigned long)(stats->count ? stats->total / stats->count : 0),
+            (unsigned)stats->overruns);
+
+        // scale the bars to the largest bucket
+        uint16_t largest = 1;
+        for (uint8_t bucket = 0; bucket < TASK_STATS_BUCKETS; bucket++)
+            if (stats->histogram[bucket] > largest)
+                largest = stats->histogram[bucket];
+
+        for (uint8_t bucket = 0; bucket < TASK_STATS_BUCKETS; bucket++)
+        {
+            bool last = bucket == TASK_STATS_BUCKETS - 1;
+            printf("  %s%5u ticks %6u |", last ? ">=" : " <", last ? 1u << bucket : 1u << (bucket + 1), stats->histogram[bucket]);
+            for (uint16_t bar = 0; bar < (uint32_t)stats->histogram[bucket] * 40 / largest; bar++)
+                putchar('#');
+            putchar('\n');
+        }
+    }
+}
+
+#endif  // __AVR__
+
+#endif  // TASK_STATS
\ No newline at end of file
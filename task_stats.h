@@ -0,0 +1,86 @@
+/** @file task_stats.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Optional instrumentation of the tasks run by `task_schedule`.
+ *         Records the execution time of each task in timer ticks, and counts deadline overruns
+ *         (a single run taking longer than the task's period).
+ *
+ *  Only compiled in when `TASK_STATS` is defined (see Makefile), otherwise every function is a no-op.
+ */
+
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <task.h>
+
+#define TASK_STATS_MAX_TASKS 8  // maximum number of tasks that can be instrumented
+#define TASK_STATS_HISTORY   4  // number of recent execution times kept for each task
+#define TASK_STATS_BUCKETS   8  // histogram buckets, bucket `i` counts runs taking < 2^(i+1) ticks
+
+typedef struct {
+    /** name of the task, shown in the report */
+    const char* name;
+
+    /** the task being instrumented, and its original data */
+    task_func_t func;
+    void* data;
+
+    /** how often the task is scheduled, in timer ticks */
+    timer_tick_t period;
+
+    /** whether the task has run since the stats were reset, `min` and `max` are only valid once it has */
+    bool sampled;
+
+    /** execution time of the task in timer ticks, `total` and `count` restart when `count` would wrap */
+    timer_tick_t min;
+    timer_tick_t max;
+    uint32_t total;
+    uint16_t count;
+
+    /** number of runs that took longer than `period`, stops at `UINT16_MAX` */
+    uint16_t overruns;
+
+    /** ring buffer of the most recent execution times */
+    timer_tick_t history[TASK_STATS_HISTORY];
+    uint8_t history_pos;
+
+    /** log2 histogram of execution times, every bucket is halved when one would overflow so the shape is kept */
+    uint16_t histogram[TASK_STATS_BUCKETS];
+} task_stats_t;
+
+#ifdef TASK_STATS
+
+/**
+ * @brief Instrument the given tasks. Each task's `func` and `data` are replaced with a wrapper
+ *        that times the original task. Must be called before `task_schedule`.
+ * @param names Name of each task, used in the report.
+ */
+void task_stats_wrap(task_t* tasks, const char* const* names, uint8_t num_tasks);
+
+/**
+ * @brief Returns the stats recorded for the task at `index`, in the order passed to `task_stats_wrap`.
+ */
+const task_stats_t* task_stats_get(uint8_t index);
+
+/**
+ * @brief Report the stats of every task. On the UCFK4 this is sent as text over the IR UART,
+ *        on the host build it is printed with a histogram of execution times.
+ */
+void task_stats_dump(void);
+
+/**
+ * @brief Clear the stats of every task.
+ */
+void task_stats_reset(void);
+
+#else
+
+#define task_stats_wrap(tasks, names, num_tasks) ((void)(names))
+#define task_stats_dump()                        ((void)0)
+#define task_stats_reset()                       ((void)0)
+
+#endif  // TASK_STATS
+
+#endif  // TASK_STATS_H
\ No newline at end of file
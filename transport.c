@@ -0,0 +1,42 @@
+/** @file transport.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief The byte stream packets are sent and received on.
+ *         On the UCFK4 this is the IR UART (`ir_transport`), the host simulations use an in-process loopback.
+ */
+
+#include "transport.h"
+
+#include <ir_uart.h>
+#include <stddef.h>
+
+static bool ir_read_ready(__unused__ void* ctx)
+{
+    return ir_uart_read_ready_p();
+}
+
+static uint8_t ir_read(__unused__ void* ctx)
+{
+    return ir_uart_getc();
+}
+
+static bool ir_write_ready(__unused__ void* ctx)
+{
+    return ir_uart_write_ready_p();
+}
+
+static void ir_write(__unused__ void* ctx, uint8_t byte)
+{
+    ir_uart_putc(byte);
+}
+
+/**
+ * Transport using the IR UART of the UCFK4.
+ */
+const transport_t ir_transport = {
+    .read_ready = ir_read_ready,
+    .read = ir_read,
+    .write_ready = ir_write_ready,
+    .write = ir_write,
+    .ctx = NULL,
+};
\ No newline at end of file
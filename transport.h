@@ -0,0 +1,36 @@
+/** @file transport.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief The byte stream packets are sent and received on.
+ *         On the UCFK4 this is the IR UART (`ir_transport`), the host simulations use an in-process loopback.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    /** whether a byte has been received and is ready to be read */
+    bool (*read_ready)(void* ctx);
+
+    /** read the next received byte, only called when `read_ready` is true */
+    uint8_t (*read)(void* ctx);
+
+    /** whether a byte can be written without waiting */
+    bool (*write_ready)(void* ctx);
+
+    /** send a byte, only called when `write_ready` is true */
+    void (*write)(void* ctx, uint8_t byte);
+
+    /** passed to each of the functions above */
+    void* ctx;
+} transport_t;
+
+/**
+ * Transport using the IR UART of the UCFK4, defined in transport.c.
+ */
+extern const transport_t ir_transport;
+
+#endif  // TRANSPORT_H
\ No newline at end of file
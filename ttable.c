@@ -0,0 +1,89 @@
+/** @file ttable.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Transposition table, a fixed size hash table of search results keyed by the position they were found for.
+ */
+
+#include "ttable.h"
+
+#ifdef __AVR__
+#define TTABLE_LOAD(word)         (word)
+#define TTABLE_STORE(word, value) ((word) = (value))
+#else
+// relaxed is enough, a torn entry is detected by its check word rather than prevented
+#define TTABLE_LOAD(word)         atomic_load_explicit(&(word), memory_order_relaxed)
+#define TTABLE_STORE(word, value) atomic_store_explicit(&(word), (value), memory_order_relaxed)
+#endif
+
+/**
+ * @brief Index of the entry a key hashes to, by fibonacci hashing of the key folded to 32 bits.
+ *        32 bit, as a 64 bit multiply is slow on the AVR.
+ */
+static uint32_t ttable_index(const ttable_t* table, uint64_t key)
+{
+    uint32_t folded = (uint32_t)key ^ (uint32_t)(key >> 32);
+    return (uint32_t)(folded * 0x9E3779B9u) >> table->shift;
+}
+
+/**
+ * @brief Initialise a table over caller provided storage, and clear every entry.
+ * @param size Number of entries, must be a power of 2 and at least 2.
+ */
+void ttable_init(ttable_t* table, ttable_entry_t* entries, uint32_t size)
+{
+    table->entries = entries;
+    table->mask = size - 1;
+    table->shift = 32;
+    for (uint32_t i = size; i > 1; i >>= 1)
+        table->shift--;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        TTABLE_STORE(entries[i].check, 0);
+        TTABLE_STORE(entries[i].data, 0);
+    }
+}
+
+/**
+ * @brief Look up the data stored for `key`.
+ * @return false if the key is not in the table.
+ */
+bool ttable_probe(const ttable_t* table, uint64_t key, uint64_t* data)
+{
+    uint32_t index = ttable_index(table, key);
+    for (uint8_t i = 0; i < TTABLE_PROBES; i++)
+    {
+        ttable_entry_t* entry = &table->entries[(index + i) & table->mask];
+        uint64_t value = TTABLE_LOAD(entry->data);
+        if ((TTABLE_LOAD(entry->check) ^ value) == key)
+        {
+            *data = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Store `data` for `key`, replacing what was stored for it, or an entry of another key if none are free.
+ */
+void ttable_store(ttable_t* table, uint64_t key, uint64_t data)
+{
+    uint32_t index = ttable_index(table, key);
+    ttable_entry_t* target = &table->entries[index];
+    for (uint8_t i = 0; i < TTABLE_PROBES; i++)
+    {
+        ttable_entry_t* entry = &table->entries[(index + i) & table->mask];
+        uint64_t check = TTABLE_LOAD(entry->check);
+        uint64_t value = TTABLE_LOAD(entry->data);
+        if ((check == 0 && value == 0) || (check ^ value) == key)
+        {
+            target = entry;
+            break;
+        }
+    }
+
+    TTABLE_STORE(target->check, key ^ data);
+    TTABLE_STORE(target->data, data);
+}
\ No newline at end of file
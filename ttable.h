@@ -0,0 +1,70 @@
+/** @file ttable.h
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Transposition table, a fixed size hash table of search results keyed by the position they were found for.
+ *
+ *  The table is open addressed, with a power of 2 number of entries. A key is looked for in the
+ *  `TTABLE_PROBES` entries from where it hashes to, and stored in the first of them that is empty or
+ *  already holds the key, or otherwise replaces the entry it hashes to.
+ *
+ *  On the host a table can be shared by many threads without a lock. Each entry is two words, the data
+ *  and the key XORed with the data, written and read with relaxed atomics. If a reader sees half of one
+ *  store and half of another, the words don't XOR back to its key and the entry is treated as missing.
+ */
+
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef __AVR__
+#include <stdatomic.h>
+#endif
+
+/** Number of entries looked at for a key, from the one it hashes to */
+#define TTABLE_PROBES 4
+
+/**
+ * An entry of the table. Both words are 0 when the entry is empty, so keys must never be 0.
+ * There are no threads on the UCFK4, so the words are plain integers there.
+ */
+typedef struct {
+#ifdef __AVR__
+    uint64_t check;
+    uint64_t data;
+#else
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+#endif
+} ttable_entry_t;
+
+typedef struct {
+    /** storage for the entries, provided by the caller */
+    ttable_entry_t* entries;
+
+    /** number of entries - 1, the number of entries is a power of 2 */
+    uint32_t mask;
+
+    /** a key's hash is shifted right by this to give the index it hashes to */
+    uint8_t shift;
+} ttable_t;
+
+/**
+ * @brief Initialise a table over caller provided storage, and clear every entry.
+ * @param size Number of entries, must be a power of 2 and at least 2.
+ */
+void ttable_init(ttable_t* table, ttable_entry_t* entries, uint32_t size);
+
+/**
+ * @brief Look up the data stored for `key`.
+ * @return false if the key is not in the table.
+ */
+bool ttable_probe(const ttable_t* table, uint64_t key, uint64_t* data);
+
+/**
+ * @brief Store `data` for `key`, replacing what was stored for it, or an entry of another key if none are free.
+ */
+void ttable_store(ttable_t* table, uint64_t key, uint64_t data);
+
+#endif  // TTABLE_H
\ No newline at end of file
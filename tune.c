@@ -0,0 +1,573 @@
+/** @file tune.c
+ *  @authors William Brown (wbr38), Matthew Wills (mwi158)
+ *  @date 16 October 2026
+ *  @brief Multi-threaded genetic tuner for the weights of the AI board evaluator, run on a host machine.
+ *
+ *  Each generation, every individual (a set of weights) plays the same games, seeded from the generation
+ *  and the game's index, and its fitness is the total number of lines it cleared. The best individuals
+ *  are kept, and the rest of the next generation is bred from tournaments between them, with uniform
+ *  crossover and random mutation of each weight.
+ *
+ *  The games of a generation are spread over a pool of worker threads, which take (individual, game)
+ *  pairs from a shared counter. Fitness is summed as integers, so the results are the same for any number
+ *  of threads. After every generation the best weights are written to `ai_weights.h`, which is compiled
+ *  into the game, and the next population is saved to the checkpoint file, which the tuner resumes from.
+ *  The checkpoint records the settings the games are played with, which replace the flags when resuming.
+ *
+ *  Usage: ./tune [-p population] [-G generations] [-g games] [-m max_pieces] [-e elite] [-t threads] [-s seed]
+ *                [-d depth] [-w beam_width] [-c checkpoint] [-o header]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "engine.h"
+
+#define TUNE_MAX_THREADS    256
+#define TUNE_MAX_POPULATION 1024
+
+// Default settings
+#define TUNE_DEFAULT_POPULATION  64
+#define TUNE_DEFAULT_GENERATIONS 50
+#define TUNE_DEFAULT_GAMES       100
+#define TUNE_DEFAULT_MAX_PIECES  1000
+#define TUNE_DEFAULT_ELITE       4
+#define TUNE_DEFAULT_SEED        1
+#define TUNE_DEFAULT_CHECKPOINT  "tune_checkpoint.txt"
+#define TUNE_DEFAULT_HEADER      "ai_weights.h"
+
+// Search settings used by the UCFK4, so the weights are tuned for the search they will be used with
+#define TUNE_DEFAULT_DEPTH      2
+#define TUNE_DEFAULT_BEAM_WIDTH 2
+
+// Number of individuals in each tournament, the fittest of them is picked as a parent
+#define TUNE_TOURNAMENT_SIZE 3
+
+// Weights are kept in [-TUNE_MAX_WEIGHT, TUNE_MAX_WEIGHT], and the first population is drawn from [-TUNE_INIT_WEIGHT, TUNE_INIT_WEIGHT]
+#define TUNE_MAX_WEIGHT  1000
+#define TUNE_INIT_WEIGHT 100
+
+// A mutation moves a weight by up to a fifth of its size, and at least this much
+#define TUNE_MIN_MUTATION 4
+
+// Version of the checkpoint file format
+#define TUNE_CHECKPOINT_VERSION 2
+
+/** Settings shared (read only) by all workers */
+typedef struct {
+    uint32_t population;
+    uint32_t generations;
+    uint32_t num_games;
+    uint32_t max_pieces;
+    uint32_t elite;
+    uint32_t num_threads;
+    uint64_t seed;
+    uint8_t depth;
+    uint8_t beam_width;
+    const char* checkpoint;
+    const char* header;
+} tune_config_t;
+
+/** A set of weights, and the totals of the games it has played this generation */
+typedef struct {
+    ai_weights_t weights;
+    _Atomic uint64_t lines;
+    _Atomic uint64_t pieces;
+} tune_individual_t;
+
+/** The totals of an individual once its games have all been played, sorted to rank the population */
+typedef struct {
+    ai_weights_t weights;
+    uint64_t lines;
+    uint64_t pieces;
+} tune_result_t;
+
+/** A generation being played, shared by all workers */
+typedef struct {
+    const tune_config_t* config;
+    uint32_t generation;
+    tune_individual_t* individuals;
+
+    /** the next (individual, game) pair to play, as `individual * num_games + game` */
+    _Atomic uint32_t next;
+
+    /** placements scored by every worker */
+    _Atomic uint64_t placements;
+} tune_generation_t;
+
+/**
+ * @brief splitmix64, used to derive independent seeds from a base seed and a game index.
+ */
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief xorshift64, the random number generator used for breeding.
+ */
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static double time_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief The weights as an array, so crossover and mutation can treat every weight the same.
+ */
+static int16_t* weights_array(ai_weights_t* weights)
+{
+    return &weights->lines;
+}
+
+#define TUNE_NUM_WEIGHTS (sizeof(ai_weights_t) / sizeof(int16_t))
+
+/**
+ * @brief Play a single game with the AI until it dies or `max_pieces` have been placed.
+ */
+static void tune_play_game(tune_generation_t* gen, tune_individual_t* individual, uint32_t game)
+{
+    const tune_config_t* config = gen->config;
+
+    // every individual plays the same games in a generation, so their fitness is compared on the same pieces
+    uint64_t game_seed = splitmix64(config->seed ^ splitmix64(((uint64_t)gen->generation << 32) | game));
+
+    engine_t engine;
+    engine_init(&engine, (uint32_t)game_seed);
+
+    ai_t ai;
+    ai_init(&ai, &individual->weights, config->depth, config->beam_width);
+
+    uint32_t pieces = 0;
+    while (engine.state == ENGINE_STATE_PLAYING && pieces < config->max_pieces)
+    {
+        // the piece is moved into place without gravity, then placed straight away by the tick after the hard drop
+        engine_input_t input = ai_next_input(&ai, &engine);
+        engine_input(&engine, input);
+        if (input == ENGINE_INPUT_DROP && engine_tick(&engine).piece_placed)
+            pieces++;
+    }
+
+    atomic_fetch_add_explicit(&individual->lines, engine.lines_cleared, memory_order_relaxed);
+    atomic_fetch_add_explicit(&individual->pieces, pieces, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gen->placements, ai.placements, memory_order_relaxed);
+}
+
+/**
+ * @brief Worker thread, plays games of the generation until they have all been taken.
+ */
+static void* tune_worker(void* arg)
+{
+    tune_generation_t* gen = arg;
+    const tune_config_t* config = gen->config;
+    uint32_t total = config->population * config->num_games;
+
+    uint32_t work;
+    while ((work = atomic_fetch_add_explicit(&gen->next, 1, memory_order_relaxed)) < total)
+        tune_play_game(gen, &gen->individuals[work / config->num_games], work % config->num_games);
+
+    return NULL;
+}
+
+/**
+ * @brief qsort comparator, fittest first, then by weights so the order is the same however qsort sorts.
+ */
+static int tune_compare(const void* a, const void* b)
+{
+    const tune_result_t* ra = a;
+    const tune_result_t* rb = b;
+    if (ra->lines != rb->lines)
+        return ra->lines > rb->lines ? -1 : 1;
+
+    return memcmp(&ra->weights, &rb->weights, sizeof(ai_weights_t));
+}
+
+static int16_t tune_clamp(int32_t weight)
+{
+    return weight < -TUNE_MAX_WEIGHT ? -TUNE_MAX_WEIGHT : weight > TUNE_MAX_WEIGHT ? TUNE_MAX_WEIGHT : weight;
+}
+
+/**
+ * @brief Pick a parent, the fittest of `TUNE_TOURNAMENT_SIZE` random individuals of the sorted population.
+ */
+static const ai_weights_t* tune_tournament(const tune_result_t* results, uint32_t count, uint64_t* rng)
+{
+    // the population is sorted, so the fittest has the lowest index
+    uint32_t best = count;
+    for (uint8_t i = 0; i < TUNE_TOURNAMENT_SIZE; i++)
+    {
+        uint32_t pick = xorshift64(rng) % count;
+        if (pick < best)
+            best = pick;
+    }
+
+    return &results[best].weights;
+}
+
+/**
+ * @brief Breed the next generation from the sorted population into `next`, keeping the `elite` fittest as they are.
+ */
+static void tune_breed(const tune_config_t* config, const tune_result_t* results, ai_weights_t* next, uint64_t* rng)
+{
+    for (uint32_t i = 0; i < config->population; i++)
+    {
+        if (i < config->elite)
+        {
+            next[i] = results[i].weights;
+            continue;
+        }
+
+        ai_weights_t a = *tune_tournament(results, config->population, rng);
+        ai_weights_t b = *tune_tournament(results, config->population, rng);
+        int16_t* child = weights_array(&next[i]);
+        for (uint8_t w = 0; w < TUNE_NUM_WEIGHTS; w++)
+        {
+            // uniform crossover, then move the weight by a random amount proportional to its size
+            int32_t weight = xorshift64(rng) & 1 ? weights_array(&a)[w] : weights_array(&b)[w];
+            int32_t range = abs(weight) / 5;
+            if (range < TUNE_MIN_MUTATION)
+                range = TUNE_MIN_MUTATION;
+
+            weight += (int32_t)(xorshift64(rng) % (2 * range + 1)) - range;
+            child[w] = tune_clamp(weight);
+        }
+    }
+}
+
+/**
+ * @brief Save the population about to be played, so a run can resume from this generation.
+ *        Written to a temporary file which then replaces the checkpoint, so an interrupted save never loses it.
+ */
+static bool tune_save_checkpoint(const tune_config_t* config, uint32_t generation, uint64_t rng, const ai_weights_t* population)
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config->checkpoint);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "tune %u\n", TUNE_CHECKPOINT_VERSION);
+    fprintf(file, "seed %llu\n", (unsigned long long)config->seed);
+    fprintf(file, "games %u\n", config->num_games);
+    fprintf(file, "max_pieces %u\n", config->max_pieces);
+    fprintf(file, "depth %u\n", config->depth);
+    fprintf(file, "beam_width %u\n", config->beam_width);
+    fprintf(file, "generation %u\n", generation);
+    fprintf(file, "rng %llu\n", (unsigned long long)rng);
+    fprintf(file, "population %u\n", config->population);
+    for (uint32_t i = 0; i < config->population; i++)
+    {
+        fprintf(file, "%d %d %d %d\n", population[i].lines, population[i].height, population[i].holes,
+                population[i].bumpiness);
+    }
+
+    bool ok = fflush(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(tmp_path, config->checkpoint) == 0;
+}
+
+/**
+ * @brief Warn if a setting is different to the one the checkpoint was made with.
+ * @return The setting the checkpoint was made with.
+ */
+static uint32_t tune_resume_setting(const char* flag, uint32_t setting, uint32_t saved)
+{
+    if (setting != saved)
+        fprintf(stderr, "the checkpoint was made with -%s %u, using it instead of %u\n", flag, saved, setting);
+    return saved;
+}
+
+/**
+ * @brief Load the population and the state of the run from a checkpoint.
+ *        The settings the checkpoint was made with replace the ones in `config`, with a warning for each one
+ *        that is different, so fitness is always measured the same way throughout a run.
+ * @return false if there is no checkpoint, or it can't be read.
+ */
+static bool tune_load_checkpoint(tune_config_t* config, uint32_t* generation, uint64_t* rng, ai_weights_t* population)
+{
+    FILE* file = fopen(config->checkpoint, "r");
+    if (!file)
+        return false;
+
+    unsigned version, gen, count, games, max_pieces, depth, beam_width;
+    unsigned long long seed, state;
+    bool ok = fscanf(file, "tune %u seed %llu games %u max_pieces %u depth %u beam_width %u generation %u rng %llu population %u",
+                     &version, &seed, &games, &max_pieces, &depth, &beam_width, &gen, &state, &count) == 9
+              && version == TUNE_CHECKPOINT_VERSION && count > 1 && count <= TUNE_MAX_POPULATION && state != 0
+              && games > 0 && (uint64_t)count * games <= UINT32_MAX - TUNE_MAX_THREADS && depth <= AI_MAX_DEPTH
+              && beam_width <= AI_MAX_BEAM_WIDTH;
+
+    for (uint32_t i = 0; ok && i < count; i++)
+    {
+        int w[TUNE_NUM_WEIGHTS];
+        ok = fscanf(file, "%d %d %d %d", &w[0], &w[1], &w[2], &w[3]) == TUNE_NUM_WEIGHTS;
+        for (uint8_t j = 0; ok && j < TUNE_NUM_WEIGHTS; j++)
+            weights_array(&population[i])[j] = tune_clamp(w[j]);
+    }
+    fclose(file);
+
+    if (!ok)
+        return false;
+
+    if (config->seed != seed)
+        fprintf(stderr, "the checkpoint was made with -s %llu, using it instead of %llu\n", seed, (unsigned long long)config->seed);
+    config->seed = seed;
+
+    config->population = tune_resume_setting("p", config->population, count);
+    config->num_games = tune_resume_setting("g", config->num_games, games);
+    config->max_pieces = tune_resume_setting("m", config->max_pieces, max_pieces);
+    config->depth = tune_resume_setting("d", config->depth, depth);
+    config->beam_width = tune_resume_setting("w", config->beam_width, beam_width);
+    *generation = gen;
+    *rng = state;
+    return true;
+}
+
+/**
+ * @brief Write the weights as a C header, which the game compiles in as `ai_default_weights`.
+ */
+static bool tune_write_header(const tune_config_t* config, uint32_t generation, const tune_result_t* best)
+{
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config->header);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file)
+        return false;
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%d %B %Y", localtime(&now));
+
+    const ai_weights_t* w = &best->weights;
+    fprintf(file, "/** @file ai_weights.h\n");
+    fprintf(file, " *  @authors William Brown (wbr38), Matthew Wills (mwi158)\n");
+    fprintf(file, " *  @date %s\n", date);
+    fprintf(file, " *  @brief Weights of the AI board evaluator, compiled in as `ai_default_weights`.\n");
+    fprintf(file, " *\n");
+    fprintf(file, " *  Generated by `./tune`, do not edit by hand. The fittest of generation %u (seed %llu), which cleared\n",
+            generation, (unsigned long long)config->seed);
+    fprintf(file, " *  %.1f lines per game over %u games, searching %u pieces with a beam width of %u.\n",
+            (double)best->lines / config->num_games, config->num_games, config->depth, config->beam_width);
+    fprintf(file, " */\n");
+    fprintf(file, "\n");
+    fprintf(file, "#ifndef AI_WEIGHTS_H\n");
+    fprintf(file, "#define AI_WEIGHTS_H\n");
+    fprintf(file, "\n");
+    fprintf(file, "#define AI_WEIGHT_LINES     %d\n", w->lines);
+    fprintf(file, "#define AI_WEIGHT_HEIGHT    %d\n", w->height);
+    fprintf(file, "#define AI_WEIGHT_HOLES     %d\n", w->holes);
+    fprintf(file, "#define AI_WEIGHT_BUMPINESS %d\n", w->bumpiness);
+    fprintf(file, "\n");
+    fprintf(file, "#endif  // AI_WEIGHTS_H");
+
+    bool ok = fflush(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(tmp_path, config->header) == 0;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [-p population] [-G generations] [-g games] [-m max_pieces] [-e elite] [-t threads] [-s seed]\n"
+            "       [-d depth] [-w beam_width] [-c checkpoint] [-o header]\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    tune_config_t config = {
+        .population = TUNE_DEFAULT_POPULATION,
+        .generations = TUNE_DEFAULT_GENERATIONS,
+        .num_games = TUNE_DEFAULT_GAMES,
+        .max_pieces = TUNE_DEFAULT_MAX_PIECES,
+        .elite = TUNE_DEFAULT_ELITE,
+        .num_threads = sysconf(_SC_NPROCESSORS_ONLN),
+        .seed = TUNE_DEFAULT_SEED,
+        .depth = TUNE_DEFAULT_DEPTH,
+        .beam_width = TUNE_DEFAULT_BEAM_WIDTH,
+        .checkpoint = TUNE_DEFAULT_CHECKPOINT,
+        .header = TUNE_DEFAULT_HEADER,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:G:g:m:e:t:s:d:w:c:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            config.population = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'G':
+            config.generations = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'g':
+            config.num_games = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'm':
+            config.max_pieces = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'e':
+            config.elite = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            config.num_threads = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'd':
+            config.depth = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'w':
+            config.beam_width = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'c':
+            config.checkpoint = optarg;
+            break;
+
+        case 'o':
+            config.header = optarg;
+            break;
+
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (config.num_threads < 1)
+        config.num_threads = 1;
+    if (config.num_threads > TUNE_MAX_THREADS)
+        config.num_threads = TUNE_MAX_THREADS;
+    if (config.population < 2 || config.population > TUNE_MAX_POPULATION || config.num_games < 1
+        || (uint64_t)config.population * config.num_games > UINT32_MAX - TUNE_MAX_THREADS)
+        usage(argv[0]);
+
+    // resume from the checkpoint if there is one, otherwise start from the compiled in weights and random ones
+    static ai_weights_t population[TUNE_MAX_POPULATION];
+    uint32_t generation = 0;
+    uint64_t rng = splitmix64(config.seed) | 1;  // xorshift state must be non-zero
+    if (tune_load_checkpoint(&config, &generation, &rng, population))
+        printf("resuming from %s at generation %u\n", config.checkpoint, generation);
+    else if (access(config.checkpoint, F_OK) == 0)
+    {
+        // don't overwrite a checkpoint that can't be resumed from, e.g. one from an older version
+        fprintf(stderr, "could not resume from %s, delete it to start a new run\n", config.checkpoint);
+        return EXIT_FAILURE;
+    }
+    else
+    {
+        population[0] = ai_default_weights;
+        for (uint32_t i = 1; i < config.population; i++)
+        {
+            for (uint8_t w = 0; w < TUNE_NUM_WEIGHTS; w++)
+                weights_array(&population[i])[w] = (int32_t)(xorshift64(&rng) % (2 * TUNE_INIT_WEIGHT + 1)) - TUNE_INIT_WEIGHT;
+        }
+    }
+
+    if (config.elite >= config.population)
+        config.elite = config.population - 1;
+
+    static tune_individual_t individuals[TUNE_MAX_POPULATION];
+    static tune_result_t results[TUNE_MAX_POPULATION];
+    pthread_t threads[TUNE_MAX_THREADS];
+    uint64_t total_games = 0;
+    uint64_t total_placements = 0;
+    double start = time_now();
+
+    for (; generation < config.generations; generation++)
+    {
+        for (uint32_t i = 0; i < config.population; i++)
+        {
+            individuals[i].weights = population[i];
+            atomic_store(&individuals[i].lines, 0);
+            atomic_store(&individuals[i].pieces, 0);
+        }
+
+        tune_generation_t gen = {
+            .config = &config,
+            .generation = generation,
+            .individuals = individuals,
+        };
+        atomic_store(&gen.next, 0);
+        atomic_store(&gen.placements, 0);
+
+        double gen_start = time_now();
+        for (uint32_t i = 0; i < config.num_threads; i++)
+            pthread_create(&threads[i], NULL, tune_worker, &gen);
+        for (uint32_t i = 0; i < config.num_threads; i++)
+            pthread_join(threads[i], NULL);
+        double gen_elapsed = time_now() - gen_start;
+
+        uint64_t lines = 0;
+        for (uint32_t i = 0; i < config.population; i++)
+        {
+            results[i] = (tune_result_t){
+                .weights = individuals[i].weights,
+                .lines = atomic_load(&individuals[i].lines),
+                .pieces = atomic_load(&individuals[i].pieces),
+            };
+            lines += results[i].lines;
+        }
+        qsort(results, config.population, sizeof(tune_result_t), tune_compare);
+
+        uint32_t games = config.population * config.num_games;
+        total_games += games;
+        total_placements += atomic_load(&gen.placements);
+
+        const tune_result_t* best = &results[0];
+        printf("gen %4u  best %8.1f  mean %8.1f lines/game  pieces %8.1f  weights %5d %5d %5d %5d  %6.0f games/s\n",
+               generation, (double)best->lines / config.num_games, (double)lines / games,
+               (double)best->pieces / config.num_games, best->weights.lines, best->weights.height,
+               best->weights.holes, best->weights.bumpiness, games / gen_elapsed);
+        fflush(stdout);
+
+        if (!tune_write_header(&config, generation, best))
+            fprintf(stderr, "failed to write %s\n", config.header);
+
+        tune_breed(&config, results, population, &rng);
+        if (!tune_save_checkpoint(&config, generation + 1, rng, population))
+            fprintf(stderr, "failed to write %s\n", config.checkpoint);
+    }
+
+    double elapsed = time_now() - start;
+    printf("threads:      %u\n", config.num_threads);
+    printf("games:        %llu\n", (unsigned long long)total_games);
+    printf("elapsed:      %.3f s\n", elapsed);
+    printf("games/s:      %.0f (%.0f per thread)\n", total_games / elapsed, total_games / elapsed / config.num_threads);
+    printf("placements/s: %.0f\n", total_placements / elapsed);
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file